@@ -17,81 +17,172 @@
 
 //*************************************************************************
 
+#include <avr/sleep.h>
+
 #include "globals.h"
 
+#include "bench.h"
+#include "capture.h"
 #include "commands.h"
 #include "eeprom_utils.h"
+#include "inject.h"
 #include "keyboard.h"
+#include "memory.h"
+#include "mouse.h"
+#include "profile.h"
+#include "scheduler.h"
 #include "serial_utils.h"
+#include "stats.h"
+#include "watchdog.h"
 
 /*************************************************************************
  * Variables
  *************************************************************************/
 bool program_mode       = false;
 
+bool at_ack_received    = false;
 bool at_clk_busy        = false;
 bool at_data_bit        = false;
 bool at_data_ready      = false;
 bool at_data_printed    = false;
+bool at_resend_request  = false;
 bool break_key_pressed  = false;
 bool ext_101_enabled    = false;
 bool ext_pressed        = false;
 bool ext_nav_pressed    = false;
 bool ext_strip_pressed  = false;
+bool inject_enabled     = false;
 bool isr_disabled       = false;
+bool kb_id_enabled      = false;
 bool key_release        = false;
+bool mouse_enabled      = false;
 bool serial_enabled     = false;
 bool sysreq_key_pressed = false;
+bool xt_reset_kb        = false;
+
+volatile bool xt_reset_request = false;
+
+bool dev_flash_on       = false;
+bool led_show_enabled   = false;
 
 bool caps_lock          = false;
 bool num_lock           = false;
 bool scroll_lock        = false;
 
-char rx_byte            = 0;
 char tx_byte            = 0;
 
 String host_command     = "";
-String last_command     = "";
 
 byte at_clk_count       = 0;
 byte at_clk_prev        = 0;
 byte at_data_byte       = 0;
 byte at_data_prev       = 0;
 byte at_data_temp       = 0;
+byte at_frame_status    = 0;
+byte at_parity          = 0;
+byte at_parity_bit      = 0;
 byte xt_data_byte       = 0;
 
+byte xt_queue[XT_QUEUE_SIZE];
+byte xt_queue_head      = 0;
+byte xt_queue_count     = 0;
+
 byte kb_leds            = 0;
 byte kb_leds_prev       = 0;
+byte kb_leds_sending    = 0;
+byte kb_leds_show       = 0;
+byte kb_leds_state      = 0;
 
+byte kb_id_state        = 0;
+unsigned int kb_id      = 0;
+unsigned long kb_id_time = 0;
+
+byte log_mask           = 0;
+
+unsigned long kb_leds_time = 0;
+unsigned long xt_busy_time = 0;
+
+unsigned int at_edge_time = 0;
+unsigned int at_frame_start = 0;
 unsigned int at_timeout = 0;
 unsigned int board_type = 0;
 unsigned int count      = 0;
 unsigned int temp       = 0;
 
-struct kb_timings
+// Keyboard LED update states
+#define LED_IDLE                0       // LED's are up to date or waiting to coalesce changes
+#define LED_WAIT_CMD_ACK        1       // 0xED sent, waiting for the keyboard ACK
+#define LED_WAIT_DATA_ACK       2       // LED byte sent, waiting for the keyboard ACK
+
+// Keyboard identification states
+#define ID_IDLE                 0       // Not identifying the keyboard
+#define ID_START                1       // Send 0xF2 once the LED's are idle
+#define ID_WAIT_ACK             2       // 0xF2 sent, waiting for the keyboard ACK
+#define ID_WAIT_BYTE_1          3       // Waiting for the first ID byte
+#define ID_WAIT_BYTE_2          4       // Waiting for the second ID byte
+
+// Board specific versions of the bus senders, selected at boot
+void sendAtCodeDev(byte sac_code);
+void sendAtCodeStd(byte sac_code);
+void sendXtCodeDev(byte sxc_code);
+void sendXtCodeStd(byte sxc_code);
+
+void (*sendAtCode)(byte) = sendAtCodeStd;
+void (*sendXtCode)(byte) = sendXtCodeStd;
+
+struct kb_timings kbt;
+
+// Run mode tasks, declared as the table below comes before the function
+// prototypes Arduino generates
+void checkXtReset(void);
+void processAtRx(void);
+void processXtQueue(void);
+void processInject(void);
+void updateKbId(void);
+void updateKbLeds(void);
+void processMouse(void);
+
+// Run mode tasks, run in this order on each pass of the main loop
+const struct sch_task run_tasks[] PROGMEM =
 {
-  byte at_bit_delay;
-  byte at_next_delay;
-  byte at_start_delay;
-  byte xt_bit_delay;
-  byte xt_next_delay;
-  byte xt_start_delay;
-} kbt;
+  {"xt_rst",  checkXtReset},
+  {"at_rx",   processAtRx},
+  {"xt_tx",   processXtQueue},
+  {"inject",  processInject},
+  {"kb_id",   updateKbId},
+  {"kb_leds", updateKbLeds},
+  {"mouse",   processMouse}
+};
 
 /*************************************************************************
  * Macro's
  *************************************************************************/
-#define LOG(x) if (serial_enabled){sHostPrint((x));}
-#define LOG_HEX(x) if (serial_enabled){sHostPrint(String((x), HEX));}
+// Categories and levels that are not built in make the test a constant
+// false, so the call and its string are compiled out.
+#define LOG_ON(cat, lvl) (((cat) & LOG_BUILD_MASK) && (lvl) <= LOG_BUILD_LEVEL && (log_mask & (cat)))
+#define LOG(cat, lvl, x) if (LOG_ON(cat, lvl)){sHostPrint(F(x));}
+#define LOG_HEX(cat, lvl, x) if (LOG_ON(cat, lvl)){sHostPrintNum((x), HEX);}
 
 /*************************************************************************
  * Setup
  *************************************************************************/
 void setup()
 {
+  // Measure the last run's peak RAM use and paint the free RAM for this run
+  memInit();
+
+  // Stop the watchdog if this is a watchdog reset
+  wdInit();
+
   // Initialise EEPROM
   eInit();
 
+  // Validate any AT frame capture and statistics that survived the reset
+  capInit();
+  stInit();
+  pfInit();
+  schInit(run_tasks, sizeof(run_tasks) / sizeof(run_tasks[0]));
+
   // Stop KB from sending data
   pinMode(AT_CLK, OUTPUT);
   digitalWrite(AT_CLK, LOW);
@@ -113,31 +204,45 @@ void setup()
   // Get the board type from EEPROM
   board_type = kGetBoardType();
 
+  // Select the bus senders for the board so the hot paths do not need to
+  // check the board type
+  if(board_type == B_DEV)
+  {
+    sendAtCode = sendAtCodeDev;
+    sendXtCode = sendXtCodeDev;
+  }
+  else
+  {
+    sendAtCode = sendAtCodeStd;
+    sendXtCode = sendXtCodeStd;
+  }
+
   // Perform board specific initialisation
   switch(board_type)
   {
     case B_DEV:
-      // Initialise output pins for the LED's
+      // Initialise output pins for the LED's. In the input capture build
+      // the AT_CLK LED pin is wired to AT_CLK, so it is left as an input.
+#ifdef AT_RX_INPUT_CAPTURE
+      pinMode(AT_CLK_ICP, INPUT_PULLUP);
+#else
       pinMode(LED_AT_CLK, OUTPUT);
+#endif
       pinMode(LED_AT_DATA, OUTPUT);
       pinMode(LED_XT_CLK, OUTPUT);
       pinMode(LED_XT_DATA, OUTPUT);
       pinMode(LED_DEV, OUTPUT);
 
-      // Flash the LED's
+      // Flash the LED's. They are turned off from the main loop by
+      // devFlashOff() so the boot is not held up.
+#ifndef AT_RX_INPUT_CAPTURE
       digitalWrite(LED_AT_CLK, HIGH);
+#endif
       digitalWrite(LED_AT_DATA, HIGH);
       digitalWrite(LED_XT_CLK, HIGH);
       digitalWrite(LED_XT_DATA, HIGH);
       digitalWrite(LED_DEV, HIGH);
-
-      delay (500);
-
-      digitalWrite(LED_AT_CLK, LOW);
-      digitalWrite(LED_AT_DATA, LOW);
-      digitalWrite(LED_XT_CLK, LOW);
-      digitalWrite(LED_XT_DATA, LOW);
-      digitalWrite(LED_DEV, LOW);
+      dev_flash_on = true;
       break;
 
     case B_STD:
@@ -162,13 +267,7 @@ void setup()
       break;
   }
 
-  // Get keyboard delay timings from EEPROM
-  kbt.at_bit_delay = kGetDelayTimings(1);
-  kbt.at_next_delay = kGetDelayTimings(2);
-  kbt.at_start_delay = kGetDelayTimings(3);
-  kbt.xt_bit_delay = kGetDelayTimings(4);
-  kbt.xt_next_delay = kGetDelayTimings(5);
-  kbt.xt_start_delay = kGetDelayTimings(6);
+  kLoadProfile();
 
   // Read config DIP switch 1
   temp = digitalRead(CONFIG_1);
@@ -180,9 +279,12 @@ void setup()
 
     // Enable serial mode in case it has been disabled in the EEPROM
     serial_enabled = true;
+    log_mask = LOG_ALL;
 
     S_HOST.begin(sHostGetBaudRate());
-    sHostPrintln(T_PROG_MODE);
+    sHostLineInput(true);
+    sHostPrintln(F(T_PROG_MODE));
+    wdReport();
   }
   else
   {
@@ -190,60 +292,77 @@ void setup()
 
     digitalWrite(LED_NANO, LOW);
 
+    // Start collecting statistics for this run
+    stClear();
+    pfStart();
+    set_sleep_mode(SLEEP_MODE_IDLE);
+
     serial_enabled = sHostGetEnabled();
 
     if(board_type == B_DEV)
     {
       checkDevOptions();
     }
+    else
+    {
+      // The serial port is used by the mouse so debug output is turned off
+      mouse_enabled = mGetEnabled();
+      if (mouse_enabled)
+      {
+        serial_enabled = false;
+      }
+    }
 
     if (serial_enabled)
     {
       // Initialise host serial port
       S_HOST.begin(sHostGetBaudRate());
-    }
+      log_mask = sHostGetLogMask();
+      if (LOG_ON(LOG_SPECIAL, LOG_ERROR))
+      {
+        wdReport();
+      }
 
-    // Enable the KB
-    pinMode(AT_CLK, INPUT_PULLUP);
-    delay(10);
+      // Text received is typed into the XT host instead of being read as
+      // command lines
+      inject_enabled = injInit();
+      sHostRawInput(inject_enabled);
+    }
 
-    // Reset keyboard
-    sendAtCode(0xFF);
-    delay(500);
-
-    // Cycle keyboard LED's
-    sendAtCode(0xED);
-    delay(kbt.at_next_delay);
-    sendAtCode(0x02);
-    delay(250);
-    sendAtCode(0xED);
-    delay(kbt.at_next_delay);
-    sendAtCode(0x04);
-    delay(250);
-    sendAtCode(0xED);
-    delay(kbt.at_next_delay);
-    sendAtCode(0x01);
-    delay(250);
-    sendAtCode(0xED);
-    delay(kbt.at_next_delay);
-    sendAtCode(0x00);
-    LOG ("\n");
-
-    // Set up the interrupt for the AT_CLK line
-    attachInterrupt(digitalPinToInterrupt(AT_CLK), INT1_ISR, FALLING);
     // Reset flags and counters
     at_data_ready = false;
     at_clk_count = 0;
 
-    if(board_type == B_DEV)
+    // Enable the KB and start receiving before resetting it so that the
+    // BAT and any early key presses are not missed
+    pinMode(AT_CLK, INPUT_PULLUP);
+    atRxEnable();
+
+    // Watch for the XT host resetting the keyboard
+    xt_reset_kb = kGetXtResetKb();
+    xtResetEnable();
+
+    // Reset keyboard. The ACK and BAT are handled by checkSpecialCase()
+    // and the BAT starts the keyboard LED cycle if enabled, and the
+    // keyboard identification.
+    led_show_enabled = kGetLedShow();
+    kb_id_enabled = kGetKbId();
+    isr_disabled = true;
+    sendAtCode(0xFF);
+    isr_disabled = false;
+    LOG(LOG_SPECIAL, LOG_INFO, "\n");
+
+    if (mouse_enabled)
     {
-      // Turn off AT_CLK LED on DEV board
-      digitalWrite(LED_AT_CLK, LOW);
+      mInit();
     }
-  }
 
-  // Get extended 101 key enabled state
-  ext_101_enabled = kGet101Enabled();
+    stBootDone();
+
+    // Reset if the main loop stops
+    wdStart();
+    schStart();
+  }
 }
 
 /*************************************************************************
@@ -251,33 +370,214 @@ void setup()
  *************************************************************************/
 void loop()
 {
+  if (dev_flash_on)
+  {
+    devFlashOff();
+  }
+
   if (program_mode)
   {
     processCommands();
   }
   else
   {
-    processKeyPress();
+    wdKick();
+    schRun();
+    idleSleep();
   }
 }
 
 /*************************************************************************
- * Sample function for use with the dev board
+ * Start the AT receiver, either on the INT1 external interrupt or on the
+ * Timer1 input capture depending on AT_RX_INPUT_CAPTURE
  *************************************************************************/
-void checkDevOptions(void)
+void atRxEnable(void)
 {
+#ifdef AT_RX_INPUT_CAPTURE
+  pinMode(AT_CLK_ICP, INPUT_PULLUP);
+
+  // Timer1 free running at 2MHz, capture on the falling edge with the
+  // noise canceller enabled
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(ICNC1) | _BV(CS11);
+  TCCR1C = 0;
+  TIFR1 = _BV(ICF1);
+  TIMSK1 = _BV(ICIE1);
+  interrupts();
+#else
+  // Set up the interrupt for the AT_CLK line
   if(board_type == B_DEV)
   {
-    if (analogRead(A0) < 128)
+    attachInterrupt(digitalPinToInterrupt(AT_CLK), INT1_ISR_DEV, FALLING);
+  }
+  else
+  {
+    attachInterrupt(digitalPinToInterrupt(AT_CLK), INT1_ISR, FALLING);
+  }
+#endif
+}
+
+/*************************************************************************
+ * Watch XT_CLK for the XT host holding it low to reset the keyboard
+ *************************************************************************/
+void xtResetEnable(void)
+{
+  // XT_CLK (D11) is PCINT3 on port B
+  noInterrupts();
+  PCMSK0 |= _BV(PCINT3);
+  PCIFR = _BV(PCIF0);
+  PCICR |= _BV(PCIE0);
+  interrupts();
+}
+
+/*************************************************************************
+ * Answer an XT host reset with the BAT code the way an XT keyboard does
+ * after its self test, resetting the AT keyboard too if enabled
+ *************************************************************************/
+void checkXtReset(void)
+{
+  if (!xt_reset_request)
+  {
+    return;
+  }
+  xt_reset_request = false;
+
+  // Anything still waiting to be sent was typed before the reset
+  xt_queue_count = 0;
+  queueXtCode(0xAA);
+  stXtReset();
+  LOG(LOG_SPECIAL, LOG_INFO, "<XT RESET>\n");
+
+  // The BIOS starts with the lock keys off and no keys held
+  kb_leds = 0;
+  injClear();
+  break_key_pressed = false;
+  sysreq_key_pressed = false;
+
+  if (xt_reset_kb)
+  {
+    // The keyboard's BAT resends the LED's
+    isr_disabled = true;
+    sendAtCode(0xFF);
+    isr_disabled = false;
+  }
+}
+
+/*************************************************************************
+ * Replay the captured AT frames through the scan code conversion with the
+ * original inter-frame timing. Gaps longer than CAP_MAX_GAP are cut short
+ * and <ctrl>-c stops the replay.
+ *************************************************************************/
+void capReplay(void)
+{
+  byte data;
+  byte status;
+  unsigned long stamp;
+  unsigned long prev = 0;
+  unsigned long due = 0;
+  unsigned long start_time = 0;
+
+  // Make sure processKeyPress() sees the AT clock as idle
+  pinMode(AT_CLK, INPUT_PULLUP);
+
+  for (byte i = 0; i < capCount(); i++)
+  {
+    capGet(i, data, status, stamp);
+    if (i == 0)
     {
-      devOptions1();
+      prev = stamp;
+      start_time = micros();
     }
-    
-    if (analogRead(A1) < 128)
+
+    // Wait until the frame is due, reading the host input so that the
+    // replay can be stopped
+    due += min(stamp - prev, CAP_MAX_GAP);
+    prev = stamp;
+    while ((micros() - start_time) < due && !sHostGetControlC())
     {
-      devOptions2();
+      sHostPoll();
     }
-    
+    if (sHostGetControlC())
+    {
+      break;
+    }
+
+    // Frames received in error were discarded and resent
+    if (status != 0)
+    {
+      continue;
+    }
+
+    at_data_byte = data;
+    at_data_ready = true;
+    processKeyPress();
+    flushXtQueue();
+  }
+  LOG(LOG_AT_RX, LOG_TRACE, "\n");
+
+  // Stop KB from sending data
+  pinMode(AT_CLK, OUTPUT);
+  digitalWrite(AT_CLK, LOW);
+}
+
+/*************************************************************************
+ * Convert one AT byte for the rollover benchmark the way the run mode
+ * tasks do, with the XT output sent to bXtSink() so that nothing is typed
+ * on the computer. processKeyPress() and each processXtQueue() call hold
+ * AT_CLK low, the XT next byte delays between codes do not.
+ *************************************************************************/
+void bKeyPress(const byte at_code, struct bench_key &key)
+{
+  void (*send_xt)(byte) = sendXtCode;
+  unsigned int start = micros();
+  unsigned int inhibit;
+
+  // Make sure processKeyPress() sees the AT clock as idle
+  pinMode(AT_CLK, INPUT_PULLUP);
+
+  sendXtCode = bXtSink;
+  at_data_byte = at_code;
+  at_data_ready = true;
+  processKeyPress();
+  key.inhibit = (unsigned int) micros() - start;
+  key.longest = key.inhibit;
+
+  // One queued code per pass of the main loop
+  while (xt_queue_count > 0)
+  {
+    inhibit = micros();
+    processXtQueue();
+    inhibit = (unsigned int) micros() - inhibit;
+    key.inhibit += inhibit;
+    key.longest = max(key.longest, inhibit);
+    delayMicroseconds(kbt.xt_next_delay);
+  }
+  key.busy = (unsigned int) micros() - start;
+  sendXtCode = send_xt;
+
+  // Stop KB from sending data
+  pinMode(AT_CLK, OUTPUT);
+  digitalWrite(AT_CLK, LOW);
+}
+
+/*************************************************************************
+ * Stands in for sendXtCode() in the rollover benchmark, taking as long as
+ * the bit delays of an XT frame
+ *************************************************************************/
+void bXtSink(byte sxc_code)
+{
+  delayMicroseconds(10 * kbt.xt_start_delay + 20 * kbt.xt_bit_delay);
+}
+
+/*************************************************************************
+ * Sample function for use with the dev board
+ *************************************************************************/
+void checkDevOptions(void)
+{
+  if(board_type == B_DEV)
+  {
+    // A0 and A1 select the timing profile, see devProfile()
     if (analogRead(A2) < 128)
     {
       devOptions3();
@@ -290,21 +590,103 @@ void checkDevOptions(void)
   }
 }
 
+/*************************************************************************
+ * The current time in the units of at_edge_time, the Timer1 count in the
+ * input capture build. Call with interrupts off as the 16 bit Timer1 read
+ * is not atomic.
+ *************************************************************************/
+static inline unsigned int atEdgeNow(void) __attribute__((always_inline));
+static inline unsigned int atEdgeNow(void)
+{
+#ifdef AT_RX_INPUT_CAPTURE
+  return TCNT1;
+#else
+  return (unsigned int) micros();
+#endif
+}
+
+/*************************************************************************
+ * Abandon a partly received frame if the keyboard has stopped clocking
+ * and ask the keyboard to resend any frame received in error
+ *************************************************************************/
+void checkAtErrors(void)
+{
+  noInterrupts();
+  if (at_clk_count > 0 && (unsigned int) (atEdgeNow() - at_timeout) > AT_BIT_TIMEOUT * AT_EDGE_TICKS)
+  {
+    at_clk_count = 0;
+    at_clk_busy = false;
+    at_resend_request = true;
+    stAtError(AT_TIMEOUT_ERROR);
+
+#ifndef AT_RX_INPUT_CAPTURE
+    if(board_type == B_DEV)
+    {
+      // Turn off AT_CLK LED
+      digitalWrite(LED_AT_CLK, LOW);
+    }
+#endif
+  }
+  interrupts();
+
+  if (at_resend_request)
+  {
+    at_resend_request = false;
+    LOG(LOG_AT_RX, LOG_ERROR, "<RESEND>");
+
+    // Stop the ISR from treating our own clock pulses as received bits
+    isr_disabled = true;
+    sendAtCode(0xFE);
+    isr_disabled = false;
+  }
+}
+
 /*************************************************************************
  * Check for scan codes that are not key presses i.e., BAT, Acks etc.
  *************************************************************************/
 bool checkSpecialCase(void)
 {
   static bool ret_val = false;
+
+  // The keyboard's answer to 0xF2 is not a key press
+  if (kb_id_state == ID_WAIT_BYTE_1 || kb_id_state == ID_WAIT_BYTE_2)
+  {
+    kb_id = (kb_id << 8) | at_data_byte;
+    kb_id_time = millis();
+    LOG_HEX(LOG_SPECIAL, LOG_INFO, at_data_byte);
+    LOG(LOG_SPECIAL, LOG_INFO, " <ID>\n");
+    if (kb_id_state == ID_WAIT_BYTE_1)
+    {
+      kb_id_state = ID_WAIT_BYTE_2;
+    }
+    else
+    {
+      selectKbModel();
+    }
+    return true;
+  }
+
   // Process data byte
   // Handle special cases that will not be passed through first
   switch(at_data_byte)
   {
     case 0xAA:
       // BAT from KB
-      LOG ("\n");
-      LOG_HEX(at_data_byte);
-      LOG (" <BAT>\n\n");
+      // The keyboard has turned its LED's off, so resend the lock states,
+      // cycling the LED's first if enabled.
+      kb_leds_prev = 0xFF;
+      if (led_show_enabled)
+      {
+        kb_leds_show = 1;
+        led_show_enabled = false;
+      }
+      if (kb_id_enabled)
+      {
+        kb_id_state = ID_START;
+      }
+      LOG(LOG_SPECIAL, LOG_INFO, "\n");
+      LOG_HEX(LOG_SPECIAL, LOG_INFO, at_data_byte);
+      LOG(LOG_SPECIAL, LOG_INFO, " <BAT>\n\n");
       ret_val = true;
       break;
 
@@ -314,21 +696,21 @@ bool checkSpecialCase(void)
       {
         if (at_data_prev == 0xE0)
         {
-          sendXtCode(at_data_prev);
-          delayMicroseconds(kbt.xt_next_delay);
+          queueXtCode(at_data_prev);
         }
       }
-      LOG_HEX (at_data_byte);
-      LOG ("\t");
+      LOG_HEX(LOG_AT_RX, LOG_TRACE, at_data_byte);
+      LOG(LOG_AT_RX, LOG_TRACE, "\t");
       key_release = true;
       ret_val = true;
       break;
 
     case 0xFA:
       // Ack from KB
-      LOG ("\n");
-      LOG_HEX(at_data_byte);
-      LOG (" <ACK>\n\n");
+      at_ack_received = true;
+      LOG(LOG_SPECIAL, LOG_INFO, "\n");
+      LOG_HEX(LOG_SPECIAL, LOG_INFO, at_data_byte);
+      LOG(LOG_SPECIAL, LOG_INFO, " <ACK>\n\n");
       ret_val = true;
       break;
 
@@ -340,19 +722,45 @@ bool checkSpecialCase(void)
 }
 
 /*************************************************************************
- * Sample function for use with the dev board
+ * Load the timing profile selected by the DEV board DIP switches or the
+ * kp command into kbt and ext_101_enabled
  *************************************************************************/
-void devOptions1(void)
+void kLoadProfile()
 {
-  return;
+  struct kb_profile data;
+  byte profile;
+
+  if (board_type == B_DEV)
+  {
+    profile = devProfile();
+  }
+  else
+  {
+    profile = kGetProfile();
+  }
+  kGetProfileData(profile, data);
+  kbt = data.timings;
+  ext_101_enabled = (data.flags & K_PF_EXT_101) != 0;
 }
 
 /*************************************************************************
- * Sample function for use with the dev board
+ * Read the timing profile number from the DEV board A0 and A1 DIP switches
+ * (A0 is bit 0, A1 is bit 1)
  *************************************************************************/
-void devOptions2(void)
+byte devProfile(void)
 {
-  return;
+  byte profile = 0;
+
+  if (analogRead(A0) < 128)
+  {
+    profile |= 0x01;
+  }
+
+  if (analogRead(A1) < 128)
+  {
+    profile |= 0x02;
+  }
+  return profile;
 }
 
 /*************************************************************************
@@ -372,6 +780,73 @@ void devOptions4(void)
   return;
 }
 
+/*************************************************************************
+ * Turn off the DEV board LED's once the boot flash time is up
+ *************************************************************************/
+void devFlashOff(void)
+{
+  if (millis() >= K_DEV_FLASH_TIME)
+  {
+#ifndef AT_RX_INPUT_CAPTURE
+    digitalWrite(LED_AT_CLK, LOW);
+#endif
+    digitalWrite(LED_AT_DATA, LOW);
+    digitalWrite(LED_XT_CLK, LOW);
+    digitalWrite(LED_XT_DATA, LOW);
+    digitalWrite(LED_DEV, LOW);
+    dev_flash_on = false;
+  }
+}
+
+/*************************************************************************
+ * Put the CPU into idle sleep until the next interrupt if there are no
+ * frames, XT codes or mouse movement waiting to be processed. The timers
+ * and UART keep running in idle mode so queued serial output is still
+ * sent, and INT1, the mouse pin change, the millis timer and the UART all
+ * wake the CPU. The millis timer also wakes tasks sleeping on a deadline.
+ *************************************************************************/
+void idleSleep(void)
+{
+  static unsigned long sleep_start;
+  static unsigned long sleep_time;
+
+  sleep_start = micros();
+  noInterrupts();
+  if (!at_data_ready && xt_queue_count == 0 && !(mouse_enabled && mPending()) && !(inject_enabled && injPending()))
+  {
+    sleep_enable();
+    // The instruction following sei is always executed before any
+    // pending interrupt, so a frame arriving here cannot be missed.
+    interrupts();
+    sleep_cpu();
+    sleep_disable();
+    sleep_time = micros() - sleep_start;
+    stSleepTime(sleep_time);
+    schSlept(sleep_time);
+  }
+  else
+  {
+    interrupts();
+    stSleepTime(0);
+  }
+}
+
+/*************************************************************************
+ * Run mode task for the AT receiver. Abandons stalled frames, asks for
+ * bad ones to be resent and translates the next received byte once the
+ * XT queue has room for the most codes one byte can queue. That is the
+ * release of a key flagged as both ext and ext nav, which queues an E0
+ * for each flag and then the scan code.
+ *************************************************************************/
+void processAtRx(void)
+{
+  checkAtErrors();
+  if (xt_queue_count <= XT_QUEUE_SIZE - 3)
+  {
+    processKeyPress();
+  }
+}
+
 /*************************************************************************
  * Process the program mode commands
  *************************************************************************/
@@ -383,50 +858,65 @@ void processCommands(void)
     checkDevOptions();
   }
 
-  // Process serial input from the host port
-  if (S_HOST.available() > 0)
+  // Run the next command line received from the host port
+  if (sHostGetLine(host_command))
   {
-    rx_byte = sHostRead();
-    sHostPrint((const String) rx_byte);
-    if (rx_byte == '\n' || rx_byte == '\r')
+    if (host_command.length() > 0)
     {
-      sHostPrintln("");
-      if (host_command.length() > 0)
-      {
-        processCommand(host_command);
-        last_command = host_command;
-        host_command = "";
-      } 
-      sHostPrompt();
-    }
-    else
-    {
-      if (rx_byte == BACK_SPACE)
-      {
-        if (host_command.length() > 0)
-        {
-          sHostPrint(" ");
-          S_HOST.write(BACK_SPACE);
-          host_command.remove(host_command.length() - 1, 1);
-        }
-        else
-        {
-          sHostPrint(">");
-        }
-      }
-      else
-      {
-        if (rx_byte == UP_ARROW)
-        {
-          host_command = host_command + last_command;
-          sHostPrint(host_command);
-        }
-        else
-        {
-          host_command = host_command + (char) rx_byte;
-        }
-      }
+      processCommand(host_command);
     }
+    sHostPrompt();
+  }
+}
+
+/*************************************************************************
+ * Queue the next XT code typed on the host serial port. Codes are queued
+ * between the keyboard's scan code sequences, once everything before
+ * them has been sent, and once the XT host has released XT_DATA after
+ * reading the last code. Hosts that never hold XT_DATA low are sent to
+ * after XT_BUSY_TIMEOUT.
+ *************************************************************************/
+void processInject(void)
+{
+  byte xt_code;
+
+  if (!inject_enabled)
+  {
+    return;
+  }
+
+  injPoll();
+  if (!injPending())
+  {
+    return;
+  }
+
+  // Don't split the keyboard's E0, F0 or Pause sequences
+  if (at_data_ready || at_clk_busy || at_data_prev == 0xE0 || at_data_prev == 0xF0 || break_key_pressed)
+  {
+    return;
+  }
+
+  if (xt_queue_count > 0)
+  {
+    return;
+  }
+
+  // The XT host holds XT_CLK low to reset the keyboard and XT_DATA low
+  // until it has read the last code
+  if (!digitalRead(XT_CLK))
+  {
+    return;
+  }
+  if (!digitalRead(XT_DATA) && (millis() - xt_busy_time) < XT_BUSY_TIMEOUT)
+  {
+    return;
+  }
+
+  if (injNext(xt_code))
+  {
+    queueXtCode(xt_code);
+    xt_busy_time = millis();
   }
 }
 
@@ -435,6 +925,9 @@ void processCommands(void)
  *************************************************************************/
 void processExtKey(void)
 {
+  PF_SPAN(PF_EXT_KEY);
+  PF_STATE(PF_ST_TRANSLATE);
+
   // Not the E0 12 ext sequence
   if (at_data_byte != 0x12)
   {
@@ -444,8 +937,7 @@ void processExtKey(void)
     {
       ext_pressed = true;
       // Send the E0
-      sendXtCode(at_data_prev);
-      delayMicroseconds(kbt.xt_next_delay);
+      queueXtCode(at_data_prev);
     }
     else
     {
@@ -458,8 +950,7 @@ void processExtKey(void)
         if (ext_101_enabled)
         {
           // Send the E0
-          sendXtCode(at_data_prev);
-          delayMicroseconds(kbt.xt_next_delay);
+          queueXtCode(at_data_prev);
         }
         else
         {
@@ -495,13 +986,63 @@ void processExtKey(void)
     xt_data_byte = 0;
   }
 
-  LOG_HEX (xt_data_byte);
+  LOG_HEX(LOG_AT_RX, LOG_TRACE, xt_data_byte);
   // Found a valid scan code?
   if (xt_data_byte != 0x00)
   {
     // Send it!
-    sendXtCode(xt_data_byte);
+    queueXtCode(xt_data_byte);
+    stFirstKey();
+  }
+}
+
+/*************************************************************************
+ * Wait up to 'timeout' uSecs for AT_CLK to read 'level'. Returns false
+ * and counts the timeout against 'reason' if it does not.
+ *************************************************************************/
+bool atWaitClk(const byte level, const unsigned int timeout, const byte reason)
+{
+  unsigned int start = micros();
+
+  WD_STATE(reason);
+  while (digitalRead(AT_CLK) != level)
+  {
+    if ((unsigned int) micros() - start > timeout)
+    {
+      wdTimeout(reason);
+      WD_STATE(WD_LOOP);
+      return false;
+    }
+  }
+  WD_STATE(WD_LOOP);
+  return true;
+}
+
+/*************************************************************************
+ * Wait for an AT frame being received to finish. A frame that takes
+ * longer than AT_BUSY_TIMEOUT is abandoned and the keyboard is asked to
+ * resend it.
+ *************************************************************************/
+void atWaitIdle(void)
+{
+  unsigned int start = micros();
+
+  WD_STATE(WD_AT_RX);
+  while (at_clk_busy)
+  {
+    if ((unsigned int) micros() - start > AT_BUSY_TIMEOUT)
+    {
+      noInterrupts();
+      at_clk_count = 0;
+      at_clk_busy = false;
+      interrupts();
+      at_resend_request = true;
+      stAtError(AT_TIMEOUT_ERROR);
+      wdTimeout(WD_AT_RX);
+      break;
+    }
   }
+  WD_STATE(WD_LOOP);
 }
 
 /*************************************************************************
@@ -512,9 +1053,15 @@ void processKeyPress(void)
   // Is there any data to process?
   if (at_data_ready)
   {
+    PF_SPAN(PF_KEY_PRESS);
+    PF_STATE(PF_ST_TRANSLATE);
+
     // Check to see if the keyboard is finished sending
     isr_disabled = true;
-    while(!digitalRead(AT_CLK));
+    if (!atWaitClk(HIGH, AT_BIT_TIMEOUT, WD_AT_RELEASE))
+    {
+      LOG(LOG_AT_RX, LOG_ERROR, "<AT CLK TIMEOUT>");
+    }
 
     // Stop keyboard from sending more data
     pinMode(AT_CLK, OUTPUT);
@@ -524,12 +1071,12 @@ void processKeyPress(void)
     if (!checkSpecialCase())
     {
       // Not a special case
-      LOG_HEX (at_data_byte);
+      LOG_HEX(LOG_AT_RX, LOG_TRACE, at_data_byte);
       
       // Current scan code is not the ext code
       if (at_data_byte != 0xE0)
       {
-        LOG("/");
+        LOG(LOG_AT_RX, LOG_TRACE, "/");
         // Is the previous scan code the ext code?
         if (at_data_byte == 0xE1)
         {
@@ -557,11 +1104,12 @@ void processKeyPress(void)
 
           processKeyRelease();
 
-          LOG_HEX (xt_data_byte);
+          LOG_HEX(LOG_AT_RX, LOG_TRACE, xt_data_byte);
           // Do we have a valid scan code
           if (xt_data_byte != 0)
           {
-            sendXtCode(xt_data_byte);
+            queueXtCode(xt_data_byte);
+            stFirstKey();
           }
 
           updateLedStatus();
@@ -573,10 +1121,10 @@ void processKeyPress(void)
           }
         }
       }
-      LOG ("\t");
+      LOG(LOG_AT_RX, LOG_TRACE, "\t");
       if (key_release)
       {
-        LOG ("\n");
+        LOG(LOG_AT_RX, LOG_TRACE, "\n");
         // Reset the flag
         key_release = false;
       }
@@ -610,8 +1158,7 @@ void processKeyRelease(void)
       if(!ext_strip_pressed)
       {
         // Send the E0
-        sendXtCode(0xE0);
-        delayMicroseconds(kbt.xt_next_delay);
+        queueXtCode(0xE0);
       }
     }
     // Is it one of the ext navigation keys?
@@ -623,8 +1170,7 @@ void processKeyRelease(void)
       if (ext_101_enabled)
       {
         // Send the E0
-        sendXtCode(0xE0);
-        delayMicroseconds(kbt.xt_next_delay);
+        queueXtCode(0xE0);
       }
     }
 
@@ -647,16 +1193,82 @@ void processKeyRelease(void)
 }
 
 /*************************************************************************
- * Send AT code to keyboard
+ * Run mode task for the serial mouse
+ *************************************************************************/
+void processMouse(void)
+{
+  if (mouse_enabled)
+  {
+    mProcess();
+  }
+}
+
+/*************************************************************************
+ * Run mode task that sends the next code waiting in the XT queue. The
+ * keyboard is held off while it is sent, and the task sleeps for the XT
+ * next byte delay after each code rather than delaying the other tasks.
+ *************************************************************************/
+void processXtQueue(void)
+{
+  if (xt_queue_count == 0)
+  {
+    return;
+  }
+
+  // Let a frame the keyboard has started finish first. AT_CLK is pulled
+  // low with interrupts off so a frame cannot start in between.
+  noInterrupts();
+  if (at_clk_busy)
+  {
+    interrupts();
+    return;
+  }
+  isr_disabled = true;
+  pinMode(AT_CLK, OUTPUT);
+  digitalWrite(AT_CLK, LOW);
+  interrupts();
+
+  sendXtCode(nextXtCode());
+
+  // Re-enable the keyboard to send data
+  pinMode(AT_CLK, INPUT_PULLUP);
+  isr_disabled = false;
+
+  schSleep(kbt.xt_next_delay);
+}
+
+/*************************************************************************
+ * Give up on a byte the keyboard has stopped clocking and release the bus
  *************************************************************************/
-void sendAtCode(byte sac_code)
+void sendAtAbort(const bool dev_leds)
 {
+  if(dev_leds)
+  {
+    digitalWrite(LED_AT_DATA, LOW);
+  }
+
+  pinMode(AT_CLK, INPUT_PULLUP);
+  pinMode(AT_DATA, INPUT_PULLUP);
+
+  LOG(LOG_AT_TX, LOG_ERROR, "<AT TX TIMEOUT>");
+}
+
+/*************************************************************************
+ * Send AT code to keyboard. 'dev_leds' is a constant in each caller so
+ * the LED code is compiled out of the non-DEV board version.
+ *************************************************************************/
+static inline void sendAtCodeBoard(byte sac_code, const bool dev_leds) __attribute__((always_inline));
+static inline void sendAtCodeBoard(byte sac_code, const bool dev_leds)
+{
+  PF_SPAN(PF_SEND_AT);
+  PF_STATE(PF_ST_AT_TX);
+
   static byte parity;
   parity = 0;
   
   // Check to see if we are processing incoming data from the AT port
   // and wait until it has completed.
-  while (at_clk_busy);
+  atWaitIdle();
 
   // Check to see if the AT clock is in use and if not, enable it.
   pinMode(AT_CLK, OUTPUT);
@@ -664,7 +1276,7 @@ void sendAtCode(byte sac_code)
   pinMode(AT_DATA, OUTPUT);
   digitalWrite(AT_DATA, HIGH);
 
-  if(board_type == B_DEV)
+  if(dev_leds)
   {
     digitalWrite(LED_AT_DATA, HIGH);
   }
@@ -681,11 +1293,15 @@ void sendAtCode(byte sac_code)
   // Finish sending start bit
   delayMicroseconds(kbt.at_bit_delay);
 
-  // Send data.
+  // Send data. The keyboard has up to AT_RTS_TIMEOUT to start clocking.
   for(int count = 0; count <8; count++)
   {
     // Wait for the AT_CLK to go low
-    while(digitalRead(AT_CLK));
+    if (!atWaitClk(LOW, count == 0 ? AT_RTS_TIMEOUT : AT_BIT_TIMEOUT, WD_AT_TX))
+    {
+      sendAtAbort(dev_leds);
+      return;
+    }
     // Send the corresponding data bit
     if (bitRead(sac_code, count))
     {
@@ -703,7 +1319,11 @@ void sendAtCode(byte sac_code)
   }
 
   // Wait for the AT_CLK line to go low
-  while(digitalRead(AT_CLK));
+  if (!atWaitClk(LOW, AT_BIT_TIMEOUT, WD_AT_TX))
+  {
+    sendAtAbort(dev_leds);
+    return;
+  }
   // Send the parity bit.
   parity = parity & 0x01;
   if(parity == 0)
@@ -718,7 +1338,7 @@ void sendAtCode(byte sac_code)
   delayMicroseconds(kbt.at_bit_delay);
   delayMicroseconds(kbt.at_bit_delay);
 
-  if(board_type == B_DEV)
+  if(dev_leds)
   {
     digitalWrite(LED_AT_DATA, LOW);
   }
@@ -727,21 +1347,37 @@ void sendAtCode(byte sac_code)
   pinMode(AT_CLK, INPUT_PULLUP);
   pinMode(AT_DATA, INPUT_PULLUP);
 
-  LOG ("[A:");
-  LOG_HEX (sac_code);
-  LOG ("]");
+  LOG(LOG_AT_TX, LOG_TRACE, "[A:");
+  LOG_HEX(LOG_AT_TX, LOG_TRACE, sac_code);
+  LOG(LOG_AT_TX, LOG_TRACE, "]");
+}
+
+void sendAtCodeDev(byte sac_code)
+{
+  sendAtCodeBoard(sac_code, true);
+}
+
+void sendAtCodeStd(byte sac_code)
+{
+  sendAtCodeBoard(sac_code, false);
 }
 
 /*************************************************************************
- * Send XT code to computer
+ * Send XT code to computer. 'dev_leds' is a constant in each caller so
+ * the LED code is compiled out of the non-DEV board version.
  *************************************************************************/
-void sendXtCode(byte sxc_code)
+static inline void sendXtCodeBoard(byte sxc_code, const bool dev_leds) __attribute__((always_inline));
+static inline void sendXtCodeBoard(byte sxc_code, const bool dev_leds)
 {
+  PF_SPAN(PF_SEND_XT);
+  PF_STATE(PF_ST_XT_TX);
+
   // Check to see if we are processing incoming data from the AT port
   // and wait until it has completed.
-  while (at_clk_busy); //incoming data so wait
+  atWaitIdle(); //incoming data so wait
 
-  if(board_type == B_DEV)
+  WD_STATE(WD_XT_TX);
+  if(dev_leds)
   {
     digitalWrite(LED_XT_CLK, HIGH);
     digitalWrite(LED_XT_DATA, HIGH);
@@ -783,27 +1419,235 @@ void sendXtCode(byte sxc_code)
   // Release the XT clock and data.
   pinMode(XT_CLK, INPUT_PULLUP);
   pinMode(XT_DATA, INPUT_PULLUP);
+  WD_STATE(WD_LOOP);
 
-  if(board_type == B_DEV)
+  if(dev_leds)
   {
     digitalWrite(LED_XT_DATA, LOW);
     digitalWrite(LED_XT_CLK, LOW);
   }
 
-  LOG ("[X:");
-  LOG_HEX (sxc_code);
-  LOG ("]");
+  LOG(LOG_XT_TX, LOG_TRACE, "[X:");
+  LOG_HEX(LOG_XT_TX, LOG_TRACE, sxc_code);
+  LOG(LOG_XT_TX, LOG_TRACE, "]");
+}
+
+void sendXtCodeDev(byte sxc_code)
+{
+  sendXtCodeBoard(sxc_code, true);
+}
+
+void sendXtCodeStd(byte sxc_code)
+{
+  sendXtCodeBoard(sxc_code, false);
+}
+
+/*************************************************************************
+ * Queue an XT code to be sent to the computer by processXtQueue()
+ *************************************************************************/
+void queueXtCode(byte code)
+{
+  if (xt_queue_count >= XT_QUEUE_SIZE)
+  {
+    LOG(LOG_XT_TX, LOG_ERROR, "<XT QUEUE FULL>");
+    return;
+  }
+  xt_queue[(xt_queue_head + xt_queue_count) % XT_QUEUE_SIZE] = code;
+  xt_queue_count++;
+}
+
+/*************************************************************************
+ * Take the next code from the XT queue, which must not be empty
+ *************************************************************************/
+byte nextXtCode(void)
+{
+  byte code = xt_queue[xt_queue_head];
+
+  xt_queue_head = (xt_queue_head + 1) % XT_QUEUE_SIZE;
+  xt_queue_count--;
+  return code;
 }
 
 /*************************************************************************
- * Update the keyboard status LED's
+ * Send everything in the XT queue straight away with the XT next byte
+ * delay between codes. Used by the capture replay and the benchmark,
+ * which translate keys outside of the run mode tasks.
+ *************************************************************************/
+void flushXtQueue(void)
+{
+  while (xt_queue_count > 0)
+  {
+    sendXtCode(nextXtCode());
+    if (xt_queue_count > 0)
+    {
+      delayMicroseconds(kbt.xt_next_delay);
+    }
+  }
+}
+
+/*************************************************************************
+ * Update the keyboard status LED's in the background. Called from the
+ * main loop, this sends one byte of the 0xED update at a time and never
+ * waits for the keyboard, so key presses keep being translated while the
+ * update is in progress. Lock key changes within K_LED_COALESCE mSecs of
+ * each other are sent as a single update. After a keyboard BAT the
+ * optional boot LED cycle is run the same way before the lock states are
+ * restored.
  *************************************************************************/
 void updateKbLeds(void)
 {
-  sendAtCode(0xED);
-  delay(kbt.at_next_delay);
-  sendAtCode(kb_leds);
-  delay(kbt.at_next_delay);
+  static const byte led_show[] PROGMEM = {0x02, 0x04, 0x01};
+
+  switch(kb_leds_state)
+  {
+    case LED_IDLE:
+      if (kb_id_state != ID_IDLE)
+      {
+        // The keyboard is being identified
+        break;
+      }
+      else if (kb_leds_show > 0)
+      {
+        // Boot LED cycle of Num, Caps then Scroll lock
+        if (kb_leds_show == 1 || (millis() - kb_leds_time) >= K_LED_SHOW_STEP)
+        {
+          if (kb_leds_show > sizeof(led_show))
+          {
+            // The last step has been lit for its time, so the lock
+            // states can now be restored
+            kb_leds_show = 0;
+            break;
+          }
+          kb_leds_sending = pgm_read_byte(&led_show[kb_leds_show - 1]);
+          kb_leds_show++;
+          LOG(LOG_LEDS, LOG_INFO, "<LED SHOW>");
+          updateKbLedsSend(0xED);
+          kb_leds_state = LED_WAIT_CMD_ACK;
+        }
+      }
+      else if (kb_leds != kb_leds_prev && (millis() - kb_leds_time) >= K_LED_COALESCE)
+      {
+        kb_leds_sending = kb_leds;
+        LOG(LOG_LEDS, LOG_INFO, "<LED>");
+        updateKbLedsSend(0xED);
+        kb_leds_state = LED_WAIT_CMD_ACK;
+      }
+      break;
+
+    case LED_WAIT_CMD_ACK:
+      if (at_ack_received)
+      {
+        updateKbLedsSend(kb_leds_sending);
+        kb_leds_state = LED_WAIT_DATA_ACK;
+      }
+      else if ((millis() - kb_leds_time) >= K_LED_ACK_TIMEOUT)
+      {
+        // No keyboard response so give up on this update
+        LOG(LOG_LEDS, LOG_ERROR, "<LED TIMEOUT>");
+        kb_leds_prev = kb_leds_sending;
+        kb_leds_state = LED_IDLE;
+      }
+      break;
+
+    case LED_WAIT_DATA_ACK:
+      if (at_ack_received || (millis() - kb_leds_time) >= K_LED_ACK_TIMEOUT)
+      {
+        kb_leds_prev = kb_leds_sending;
+        kb_leds_state = LED_IDLE;
+      }
+      break;
+
+    default:
+      kb_leds_state = LED_IDLE;
+      break;
+  }
+}
+
+/*************************************************************************
+ * Identify the keyboard after its BAT so the timings proven for that model
+ * can be used. Like updateKbLeds(), this is called from the main loop and
+ * never waits for the keyboard. An MF2 keyboard answers 0xF2 with an ACK
+ * and 2 ID bytes, an 84 key AT keyboard with only the ACK.
+ *************************************************************************/
+void updateKbId(void)
+{
+  switch(kb_id_state)
+  {
+    case ID_START:
+      if (kb_leds_state == LED_IDLE)
+      {
+        kb_id = 0;
+        LOG(LOG_SPECIAL, LOG_INFO, "<IDENTIFY>");
+        updateKbLedsSend(0xF2);
+        kb_id_time = millis();
+        kb_id_state = ID_WAIT_ACK;
+      }
+      break;
+
+    case ID_WAIT_ACK:
+      if (at_ack_received)
+      {
+        kb_id_time = millis();
+        kb_id_state = ID_WAIT_BYTE_1;
+      }
+      else if ((millis() - kb_id_time) >= K_ID_TIMEOUT)
+      {
+        // No keyboard response so keep the profile timings
+        LOG(LOG_SPECIAL, LOG_ERROR, "<ID TIMEOUT>");
+        kb_id_state = ID_IDLE;
+      }
+      break;
+
+    case ID_WAIT_BYTE_1:
+    case ID_WAIT_BYTE_2:
+      // The ID is complete if no more bytes arrive
+      if ((millis() - kb_id_time) >= K_ID_TIMEOUT)
+      {
+        selectKbModel();
+      }
+      break;
+
+    default:
+      kb_id_state = ID_IDLE;
+      break;
+  }
+}
+
+/*************************************************************************
+ * Use the AT timings of the model matching the keyboard ID and clock
+ * period, otherwise keep those of the timing profile
+ *************************************************************************/
+void selectKbModel(void)
+{
+  struct kb_model model;
+  byte clock = min(stGetAtClock(), 255);
+  byte index = kFindModel(kb_id, clock, model);
+
+  stKbId(kb_id, clock, index);
+  if (index < K_MODELS)
+  {
+    kbt.at_bit_delay = model.at_bit_delay;
+    kbt.at_next_delay = model.at_next_delay;
+    kbt.at_start_delay = model.at_start_delay;
+    LOG(LOG_SPECIAL, LOG_INFO, "<MODEL ");
+    LOG_HEX(LOG_SPECIAL, LOG_INFO, index);
+    LOG(LOG_SPECIAL, LOG_INFO, ">\n");
+  }
+  kb_id_state = ID_IDLE;
+}
+
+/*************************************************************************
+ * Send one byte of a keyboard LED update, or the identify command
+ *************************************************************************/
+void updateKbLedsSend(byte code)
+{
+  at_ack_received = false;
+  kb_leds_time = millis();
+
+  // Stop the ISR from treating our own clock pulses as received bits
+  isr_disabled = true;
+  sendAtCode(code);
+  isr_disabled = false;
 }
 
 /*************************************************************************
@@ -811,6 +1655,11 @@ void updateKbLeds(void)
  *************************************************************************/
 void updateLedStatus(void)
 {
+  PF_SPAN(PF_LED_STATUS);
+
+  static byte leds_before;
+  leds_before = kb_leds;
+
   // Handle the toggle keys that have LED's
   switch(at_data_byte)
   {
@@ -863,24 +1712,31 @@ void updateLedStatus(void)
       break;
   }
 
-  // Has the keyboard LED states changed?
-  if(kb_leds != kb_leds_prev)
+  // Start the coalescing period again if the keyboard LED states changed.
+  // The update itself is sent from the main loop by updateKbLeds().
+  if(kb_leds != leds_before && kb_leds_state == LED_IDLE)
   {
-    updateKbLeds();
-    kb_leds_prev = kb_leds;
+    kb_leds_time = millis();
   }
 }
 
 /*************************************************************************
- * Interrupt Service Routine
+ * Process a falling AT_CLK edge at time at_edge_time, which counts
+ * AT_EDGE_TICKS per uSec. Called from the receiver interrupts with
+ * 'dev_leds' as a constant so the LED code is compiled out of the non-DEV
+ * board version.
  *************************************************************************/
-void INT1_ISR(void)
+static inline void atRxEdge(const bool dev_leds) __attribute__((always_inline));
+static inline void atRxEdge(const bool dev_leds)
 {
-  // Are we still processing the previous key press?
-  if(isr_disabled)
+  // Resynchronise if it has been too long since the last clock edge. The
+  // edge that ends the timeout is taken as the start bit of a new frame.
+  if (at_clk_count > 0 && (unsigned int) (at_edge_time - at_timeout) > AT_BIT_TIMEOUT * AT_EDGE_TICKS)
   {
-    return;
+    at_clk_count = 0;
+    stAtError(AT_TIMEOUT_ERROR);
   }
+  at_timeout = at_edge_time;
 
   at_clk_busy = true;
   at_clk_count++;
@@ -888,13 +1744,15 @@ void INT1_ISR(void)
   // Start bit
   if (at_clk_count == 1)
   {
-    if(board_type == B_DEV)
+    if(dev_leds)
     {
       // Turn on AT_CLK LED
       digitalWrite(LED_AT_CLK, HIGH);
     }
     at_data_byte = 0;
     at_data_temp = 0;
+    at_parity = 0;
+    at_frame_start = at_edge_time;
   }
   else // Data bits
   {
@@ -906,22 +1764,129 @@ void INT1_ISR(void)
       {
         at_data_temp = bitSet(at_data_byte, (at_clk_count - 2));
         at_data_byte = at_data_temp;
+        at_parity ^= 1;
       }
     }
+    else if (at_clk_count == 10)
+    {
+      // Parity bit
+      at_parity_bit = digitalRead(AT_DATA);
+      at_parity ^= at_parity_bit;
+    }
   }
 
   // Stop bit
   if (at_clk_count >= 11)
   {
+    // Odd parity over the data and parity bits, stop bit must be high
+    at_frame_status = 0;
+    if (at_parity == 0)
+    {
+      at_frame_status |= AT_PARITY_ERROR;
+    }
+    if (!digitalRead(AT_DATA))
+    {
+      at_frame_status |= AT_STOP_ERROR;
+    }
+    capRecord(at_data_byte, at_frame_status);
+    stAtClock(at_edge_time - at_frame_start);
+
     // Reset flags and counters
     at_clk_count = 0;
-    at_data_ready = true;
     at_clk_busy = false;
 
-    if(board_type == B_DEV)
+    if (at_frame_status == 0)
+    {
+      at_data_ready = true;
+    }
+    else
+    {
+      // Discard the frame and have it resent from the main loop
+      at_resend_request = true;
+      stAtError(at_frame_status);
+    }
+
+    if(dev_leds)
     {
       // Turn off AT_CLK LED
       digitalWrite(LED_AT_CLK, LOW);
     }
   }
 }
+
+/*************************************************************************
+ * Interrupt Service Routine
+ *************************************************************************/
+// XT_CLK changed. A reset is XT_CLK held low for XT_RESET_TIME or longer,
+// which also filters out our own clock pulses when sending to the host.
+ISR(PCINT0_vect)
+{
+  static bool xt_clk_low = false;
+  static unsigned long xt_clk_low_time = 0;
+
+  if (!digitalRead(XT_CLK))
+  {
+    xt_clk_low = true;
+    xt_clk_low_time = micros();
+  }
+  else if (xt_clk_low)
+  {
+    xt_clk_low = false;
+    if (micros() - xt_clk_low_time >= XT_RESET_TIME)
+    {
+      xt_reset_request = true;
+    }
+  }
+}
+
+#ifdef AT_RX_INPUT_CAPTURE
+ISR(TIMER1_CAPT_vect)
+{
+  static unsigned int latency;
+
+  // Are we still processing the previous key press?
+  if(isr_disabled)
+  {
+    return;
+  }
+
+  PF_SPAN(PF_AT_RX);
+
+  // The edge time is the Timer1 count the hardware captured at the edge
+  at_edge_time = ICR1;
+  latency = TCNT1 - at_edge_time;
+  if (latency > AT_LATE_TICKS)
+  {
+    stAtError(AT_LATE_ERROR);
+  }
+
+  // The DEV board AT_CLK LED pin is the input capture pin
+  atRxEdge(false);
+}
+#else
+void INT1_ISR(void)
+{
+  // Are we still processing the previous key press?
+  if(isr_disabled)
+  {
+    return;
+  }
+
+  PF_SPAN(PF_AT_RX);
+  at_edge_time = (unsigned int) micros();
+  atRxEdge(false);
+}
+
+void INT1_ISR_DEV(void)
+{
+  // Are we still processing the previous key press?
+  if(isr_disabled)
+  {
+    return;
+  }
+
+  PF_SPAN(PF_AT_RX);
+  at_edge_time = (unsigned int) micros();
+  atRxEdge(true);
+}
+#endif
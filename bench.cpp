@@ -0,0 +1,381 @@
+/*
+ * bench.cpp
+ * 
+ * On device micro-benchmarks for the hot paths.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "bench.h"
+#include "commands.h"
+#include "eeprom_utils.h"
+#include "keyboard.h"
+#include "serial_utils.h"
+
+// Number of times each benchmark is repeated
+#define B_ITERATIONS            200
+
+// Benchmark identifiers
+#define B_AT2XT                 0
+#define B_AT2XT_EXT             1
+#define B_COMMAND               2
+#define B_CRC                   3
+#define B_LOG                   4
+#define B_ROLLOVER              5
+#define B_LAST_BENCH            6
+
+// Rollover stress scenario. Bursts of held keys, with E0 navigation keys
+// mixed in, then typematic repeats of the last key and a Caps Lock LED
+// toggle on and off before the keys are released. Runs in simulated time
+// so that it does not have to wait out the typematic delays.
+#define B_ROUNDS                10      // Bursts of held keys
+#define B_BURST_MIN             6       // Keys held in the smallest burst
+#define B_BURST_MAX             10      // Keys held in the largest burst
+#define B_TYPEMATIC             10      // Repeats of the last key held
+#define B_TYPEMATIC_US          33333   // Typematic repeat at 30 characters per second
+#define B_ROUND_US              100000  // Gap before each burst
+#define B_AT_FRAME_US           1100    // Back to back keyboard frames at about 10kHz
+#define B_KB_BUFFER             16      // Bytes a keyboard holds while AT_CLK is inhibited, AT_CLK is released between XT codes
+
+struct bench_limit
+{
+  char name[10];
+  unsigned long max_cycles;
+};
+
+// Limits in CPU cycles per operation, a result above the limit is
+// reported as a regression. These are PLACEHOLDERS estimated from the code,
+// not measured on a board. Replace them with the results of a known good
+// run plus some headroom and clear B_LIMITS_PLACEHOLDER, and update them
+// again when the code is deliberately changed.
+#define B_LIMITS_PLACEHOLDER    true
+
+static const struct bench_limit bench_limits[B_LAST_BENCH] PROGMEM =
+{
+  {"at2xt", 1200},
+  {"at2xt_ext", 400},
+  {"command", 20000},
+  {"crc", 6000},
+  {"log", 1500},
+  {"rollover", 20000}
+};
+
+// Representative set 2 scan codes for the translation benchmarks
+static const byte bench_codes[] PROGMEM =
+{
+  0x1C, 0x1B, 0x23, 0x2B, 0x29, 0x5A, 0x12, 0x14,
+  0x05, 0x78, 0x7C, 0x71, 0x66, 0x0D, 0x76, 0x4A
+};
+
+static const byte bench_codes_ext[] PROGMEM =
+{
+  0x1F, 0x11, 0x27, 0x14, 0x2F, 0x75, 0x72, 0x6B
+};
+
+static volatile byte b_sink;
+
+struct bench_stress
+{
+  unsigned long due;            // Simulated uSecs the next byte leaves the keyboard
+  unsigned long clock;          // Simulated uSecs the keyboard can send again
+  unsigned long inhibit;        // uSecs spent with AT_CLK inhibited
+  unsigned long busy;           // uSecs spent translating and sending, including the XT next byte delays
+  unsigned int bytes;           // AT bytes converted
+  unsigned int keys;            // Key presses including typematic repeats
+  unsigned int dropped;         // Bytes that would have overflowed the keyboard buffer
+  unsigned int max_inhibit;     // Longest uSecs AT_CLK was inhibited at a time
+  byte max_depth;               // Most bytes waiting in the keyboard
+  byte round_depth;             // Most bytes waiting in the keyboard this round
+  byte depth[B_ROUNDS];         // round_depth of each round
+  unsigned int end_ms[B_ROUNDS]; // Simulated mSecs each round finished
+};
+
+static struct bench_stress bs;
+
+//*************************************************************************
+// Converts one AT byte due 'gap' uSecs after the previous one. Bytes that
+// arrive while AT_CLK is inhibited wait in the keyboard. A byte that
+// would overflow the keyboard buffer is counted as dropped but is still
+// converted so the key states stay consistent.
+static void bStressByte(const byte at_code, const unsigned long gap)
+{
+  struct bench_key key;
+  byte depth = 0;
+
+  bs.due += gap;
+  if (bs.clock > bs.due)
+  {
+    depth = (bs.clock - bs.due) / B_AT_FRAME_US + 1;
+  }
+  else
+  {
+    bs.clock = bs.due;
+  }
+
+  if (depth > B_KB_BUFFER)
+  {
+    bs.dropped++;
+  }
+  if (depth > bs.round_depth)
+  {
+    bs.round_depth = depth;
+  }
+
+  // The keyboard is only held off while AT_CLK is low. The XT next byte
+  // delays between the queued codes leave it free to send.
+  bKeyPress(at_code, key);
+  bs.clock += key.inhibit;
+  bs.inhibit += key.inhibit;
+  bs.busy += key.busy;
+  bs.bytes++;
+  if (key.longest > bs.max_inhibit)
+  {
+    bs.max_inhibit = key.longest;
+  }
+}
+
+//*************************************************************************
+// Sends the make or break codes of key 'i' of a burst, every third key
+// being an E0 navigation key.
+static void bStressKey(const byte round, const byte i, const bool release, const unsigned long gap)
+{
+  unsigned long next = gap;
+
+  if (i % 3 == 2)
+  {
+    bStressByte(0xE0, next);
+    next = B_AT_FRAME_US;
+  }
+  if (release)
+  {
+    bStressByte(0xF0, next);
+    next = B_AT_FRAME_US;
+  }
+  if (i % 3 == 2)
+  {
+    bStressByte(pgm_read_byte(&bench_codes_ext[(round + i) % sizeof(bench_codes_ext)]), next);
+  }
+  else
+  {
+    bStressByte(pgm_read_byte(&bench_codes[(round * 3 + i) % sizeof(bench_codes)]), next);
+  }
+}
+
+//*************************************************************************
+// Runs the rollover stress scenario and returns the CPU cycles per AT byte
+// spent with AT_CLK inhibited
+static unsigned long bStress()
+{
+  byte keys;
+  byte i;
+
+  memset(&bs, 0, sizeof(bs));
+  for (byte round = 0; round < B_ROUNDS; round++)
+  {
+    bs.round_depth = 0;
+    keys = B_BURST_MIN + round % (B_BURST_MAX - B_BURST_MIN + 1);
+
+    for (i = 0; i < keys; i++)
+    {
+      bStressKey(round, i, false, i == 0 ? B_ROUND_US : B_AT_FRAME_US);
+      bs.keys++;
+    }
+    for (i = 0; i < B_TYPEMATIC; i++)
+    {
+      bStressKey(round, keys - 1, false, B_TYPEMATIC_US);
+      bs.keys++;
+    }
+
+    // Caps Lock on then off again, each changing the keyboard LED's
+    for (i = 0; i < 2; i++)
+    {
+      bStressByte(0x58, B_AT_FRAME_US);
+      bStressByte(0xF0, B_AT_FRAME_US);
+      bStressByte(0x58, B_AT_FRAME_US);
+      bs.keys++;
+    }
+
+    for (i = 0; i < keys; i++)
+    {
+      bStressKey(round, i, true, B_AT_FRAME_US);
+    }
+
+    if (bs.round_depth > bs.max_depth)
+    {
+      bs.max_depth = bs.round_depth;
+    }
+
+    // Keyboard buffer use over time, printed once the benchmark is done
+    bs.depth[round] = bs.round_depth;
+    bs.end_ms[round] = bs.clock / 1000;
+  }
+
+  return bs.inhibit * clockCyclesPerMicrosecond() / bs.bytes;
+}
+
+//*************************************************************************
+static void bStressPrint()
+{
+  sHostPrint(F("STRESS,bytes,"));
+  sHostPrintNum(bs.bytes, DEC);
+  sHostPrintln();
+  sHostPrint(F("STRESS,keys_per_s,"));
+  sHostPrintNum(bs.busy ? bs.keys * 1000000UL / bs.busy : 0, DEC);
+  sHostPrintln();
+  sHostPrint(F("STRESS,max_inhibit_us,"));
+  sHostPrintNum(bs.max_inhibit, DEC);
+  sHostPrintln();
+  sHostPrint(F("STRESS,max_depth,"));
+  sHostPrintNum(bs.max_depth, DEC);
+  sHostPrintln();
+  sHostPrint(F("STRESS,dropped,"));
+  sHostPrintNum(bs.dropped, DEC);
+  sHostPrintln();
+
+  for (byte round = 0; round < B_ROUNDS; round++)
+  {
+    sHostPrint(F("STRESS,depth,"));
+    sHostPrintNum(bs.end_ms[round], DEC);
+    sHostPrint(',');
+    sHostPrintNum(bs.depth[round], DEC);
+    sHostPrintln();
+  }
+}
+
+//*************************************************************************
+static unsigned long bRunOne(byte bench)
+{
+  unsigned long start_time;
+  unsigned long elapsed;
+  byte j;
+
+  if (bench == B_ROLLOVER)
+  {
+    return bStress();
+  }
+
+  start_time = micros();
+  for (unsigned int i = 0; i < B_ITERATIONS; i++)
+  {
+    switch(bench)
+    {
+      case B_AT2XT:
+        for (j = 0; j < sizeof(bench_codes); j++)
+        {
+          b_sink = AT2XT(pgm_read_byte(&bench_codes[j]));
+        }
+        break;
+
+      case B_AT2XT_EXT:
+        for (j = 0; j < sizeof(bench_codes_ext); j++)
+        {
+          b_sink = AT2XTExt(pgm_read_byte(&bench_codes_ext[j]));
+          b_sink = AT2XTExtNav(pgm_read_byte(&bench_codes_ext[j]));
+        }
+        break;
+
+      case B_COMMAND:
+        processCommand(F("kabd"));
+        break;
+
+      case B_CRC:
+        b_sink = (byte) eCrc();
+        break;
+
+      case B_LOG:
+        sHostPrintNum(0xE0, HEX);
+        sHostPrint(F("\t"));
+        break;
+
+      default:
+        break;
+    }
+  }
+  elapsed = micros() - start_time;
+
+  elapsed = elapsed * clockCyclesPerMicrosecond() / B_ITERATIONS;
+  switch(bench)
+  {
+    case B_AT2XT:
+      elapsed = elapsed / sizeof(bench_codes);
+      break;
+
+    case B_AT2XT_EXT:
+      elapsed = elapsed / (2 * sizeof(bench_codes_ext));
+      break;
+
+    default:
+      break;
+  }
+  return elapsed;
+}
+
+//*************************************************************************
+bool bRun()
+{
+  bool passed = true;
+  unsigned long cycles;
+  unsigned long limit;
+
+  if (B_LIMITS_PLACEHOLDER)
+  {
+    sHostPrintln(F("BENCH,limits,PLACEHOLDER"));
+  }
+
+  for (byte bench = 0; bench < B_LAST_BENCH; bench++)
+  {
+    // The command and log benchmarks measure the processing cost only,
+    // not the time taken to send the characters over the serial port.
+    // Their output is formatted into the quiet sink instead.
+    sHostQuiet(true);
+    cycles = bRunOne(bench);
+    sHostQuiet(false);
+
+    limit = pgm_read_dword(&bench_limits[bench].max_cycles);
+
+    sHostPrint(F("BENCH,"));
+    sHostPrint((const __FlashStringHelper *) bench_limits[bench].name);
+    sHostPrint(',');
+    sHostPrintNum(bench == B_ROLLOVER ? bs.bytes : B_ITERATIONS, DEC);
+    sHostPrint(',');
+    sHostPrintNum(cycles, DEC);
+    sHostPrint(',');
+    sHostPrintNum(limit, DEC);
+    if (cycles > limit)
+    {
+      passed = false;
+      sHostPrintln(F(",FAIL"));
+    }
+    else
+    {
+      sHostPrintln(F(",PASS"));
+    }
+
+    if (bench == B_ROLLOVER)
+    {
+      bStressPrint();
+    }
+  }
+
+  if (passed)
+  {
+    sHostPrintln(F("BENCH,result,PASS"));
+  }
+  else
+  {
+    sHostPrintln(F("BENCH,result,FAIL"));
+  }
+  return passed;
+}
@@ -0,0 +1,62 @@
+#ifndef _BENCH_H_
+#define _BENCH_H_
+
+/*
+ * bench.h
+ * 
+ * On device micro-benchmarks for the hot paths.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+/*************************************************************************
+ * bRun
+ * 
+ * Runs each benchmark and prints one comma separated result line per
+ * benchmark in the form:
+ *   BENCH,<name>,<iterations>,<cycles per op>,<limit>,<PASS|FAIL>
+ * followed by a BENCH,result,<PASS|FAIL> summary line. The rollover
+ * benchmark reports cycles per AT byte over its stress scenario and adds
+ * STRESS,<name>,<value> lines for the sustainable keys per second, the
+ * longest single AT_CLK inhibit, the keyboard buffer depth and dropped
+ * bytes, and STRESS,depth,<mSecs>,<depth> lines for the buffer depth over
+ * time. A BENCH,limits,PLACEHOLDER line comes first while the limits
+ * are still estimates rather than taken from a measured run.
+ *
+ * Returns false if any result is above its stored limit.
+ *************************************************************************/
+bool bRun();
+
+// Timings of one AT byte converted by bKeyPress()
+struct bench_key
+{
+  unsigned int inhibit;         // Total uSecs AT_CLK was held low
+  unsigned int longest;         // Longest uSecs AT_CLK was held low at a time
+  unsigned int busy;            // uSecs until the XT queue was empty again
+};
+
+/*************************************************************************
+ * bKeyPress / bXtSink
+ * 
+ * Defined in PS2KBTool.ino. bKeyPress() converts 'at_code' the way the
+ * run mode tasks do, as if just received from the keyboard. It is
+ * translated by processKeyPress(), which holds AT_CLK low while it runs,
+ * then the XT queue is emptied by processXtQueue(), one code at a time.
+ * Each code holds AT_CLK low while it is sent and is followed by the XT
+ * next byte delay with AT_CLK released. The times are returned in 'key'.
+ * While it runs the XT output goes to bXtSink(), which takes the time of
+ * an XT frame at the current timings without typing anything on the
+ * computer.
+ *************************************************************************/
+void bKeyPress(const byte at_code, struct bench_key &key);
+void bXtSink(byte sxc_code);
+
+#endif // _BENCH_H_
@@ -0,0 +1,163 @@
+/*
+ * capture.cpp
+ * 
+ * Raw AT frame capture for diagnosing field failures.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include "globals.h"
+
+#include "capture.h"
+#include "eeprom_utils.h"
+#include "serial_utils.h"
+
+#define CAP_MAGIC               0xCA97
+
+struct cap_frame
+{
+  unsigned long stamp;
+  byte data;
+  byte status;
+};
+
+// The ring lives in .noinit so that it survives the reset into program
+// mode. It is only trusted if the magic value and indexes are sane.
+static struct cap_frame cap_ring[CAP_SIZE] __attribute__((section(".noinit")));
+static unsigned int cap_magic __attribute__((section(".noinit")));
+static byte cap_head __attribute__((section(".noinit")));
+static byte cap_frames __attribute__((section(".noinit")));
+
+static bool cap_enabled = false;
+
+//*************************************************************************
+void capInit()
+{
+  if (cap_magic != CAP_MAGIC || cap_head >= CAP_SIZE || cap_frames > CAP_SIZE)
+  {
+    capClear();
+  }
+  cap_enabled = capGetEnabled();
+}
+
+//*************************************************************************
+void capClear()
+{
+  noInterrupts();
+  cap_head = 0;
+  cap_frames = 0;
+  cap_magic = CAP_MAGIC;
+  interrupts();
+}
+
+//*************************************************************************
+void capRecord(const byte data, const byte status)
+{
+  if (!cap_enabled)
+  {
+    return;
+  }
+
+  cap_ring[cap_head].stamp = micros();
+  cap_ring[cap_head].data = data;
+  cap_ring[cap_head].status = status;
+
+  cap_head++;
+  if (cap_head >= CAP_SIZE)
+  {
+    cap_head = 0;
+  }
+  if (cap_frames < CAP_SIZE)
+  {
+    cap_frames++;
+  }
+}
+
+//*************************************************************************
+byte capCount()
+{
+  return cap_frames;
+}
+
+//*************************************************************************
+void capGet(const byte index, byte &data, byte &status, unsigned long &stamp)
+{
+  byte slot = (cap_head + CAP_SIZE - cap_frames + index) % CAP_SIZE;
+
+  noInterrupts();
+  data = cap_ring[slot].data;
+  status = cap_ring[slot].status;
+  stamp = cap_ring[slot].stamp;
+  interrupts();
+}
+
+//*************************************************************************
+void capPrint()
+{
+  byte data;
+  byte status;
+  unsigned long stamp;
+  unsigned long first = 0;
+
+  for (byte i = 0; i < capCount(); i++)
+  {
+    capGet(i, data, status, stamp);
+    if (i == 0)
+    {
+      first = stamp;
+    }
+    sHostPrint(F("CAP,"));
+    sHostPrintNum(i, DEC);
+    sHostPrint(',');
+    sHostPrintNum(stamp - first, DEC);
+    sHostPrint(',');
+    sHostPrintHex(data);
+    sHostPrint(',');
+    sHostPrintNum(status, DEC);
+    sHostPrintln();
+  }
+}
+
+//*************************************************************************
+void capEnabled(const bool value)
+{
+  if (value)
+  {
+    cap_enabled = 1;
+    // Start a fresh capture
+    capClear();
+  }
+  else
+  {
+    cap_enabled = 0;
+  }
+  ePut(E_CAPTURE_ENABLED, (byte) cap_enabled);
+  eUpdateCrc();
+}
+
+//*************************************************************************
+bool capGetEnabled()
+{
+  byte value = 0;
+
+  eGet(E_CAPTURE_ENABLED, value);
+  if (value == 0)
+  {
+    return false;
+  }
+  else
+  {
+    return true;
+  }
+}
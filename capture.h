@@ -0,0 +1,94 @@
+#ifndef _CAPTURE_H_
+#define _CAPTURE_H_
+
+/*
+ * capture.h
+ * 
+ * Raw AT frame capture for diagnosing field failures.
+ * 
+ * Received frames are recorded with a timestamp and the parity/stop bit
+ * status into a RAM ring that is not cleared on reset, so a capture taken
+ * in run mode can be dumped after resetting into program mode.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+// Number of frames held in the capture ring
+#define CAP_SIZE                32
+
+// Longest uSecs the replay waits between frames, idle gaps are cut short
+#define CAP_MAX_GAP             1000000UL
+
+/*************************************************************************
+ * capInit
+ * 
+ * Validates the capture ring after a reset and loads the capture enabled
+ * flag from EEPROM. Call once from setup().
+ *************************************************************************/
+void capInit();
+
+/*************************************************************************
+ * capClear
+ * 
+ * Empties the capture ring.
+ *************************************************************************/
+void capClear();
+
+/*************************************************************************
+ * capRecord
+ * 
+ * Records a received frame and its AT_xxx_ERROR status bits if capturing
+ * is enabled. Called from the AT clock ISR once the stop bit has been
+ * read.
+ *************************************************************************/
+void capRecord(const byte data, const byte status);
+
+/*************************************************************************
+ * capCount
+ * 
+ * Returns the number of frames in the capture ring.
+ *************************************************************************/
+byte capCount();
+
+/*************************************************************************
+ * capGet
+ * 
+ * Returns the frame 'index' (0 is the oldest) from the capture ring.
+ *************************************************************************/
+void capGet(const byte index, byte &data, byte &status, unsigned long &stamp);
+
+/*************************************************************************
+ * capPrint
+ * 
+ * Prints the capture ring to the host serial port, one frame per line:
+ *   CAP,<frame>,<uSec since first frame>,<data>,<status>
+ *************************************************************************/
+void capPrint();
+
+/*************************************************************************
+ * capReplay
+ * 
+ * Feeds the captured frames back through processKeyPress() with the
+ * original inter-frame timing, with gaps cut to CAP_MAX_GAP. Stops early
+ * if <ctrl>-c is received. Implemented in PS2KBTool.ino alongside the
+ * translation state.
+ *************************************************************************/
+void capReplay();
+
+/*************************************************************************
+ * capEnabled / capGetEnabled
+ * 
+ * Turns on or off frame capturing, saved in EEPROM.
+ *************************************************************************/
+void capEnabled(const bool value);
+bool capGetEnabled();
+
+#endif // _CAPTURE_H_
@@ -19,177 +19,395 @@
 
 #include "globals.h"
 
+#include "bench.h"
+#include "capture.h"
 #include "commands.h"
 #include "eeprom_utils.h"
 #include "keyboard.h"
+#include "memory.h"
+#include "mouse.h"
+#include "profile.h"
+#include "scheduler.h"
 #include "serial_utils.h"
+#include "stats.h"
+#include "watchdog.h"
+
+// Command groups, in the order they are listed by help and ?
+#define C_KEYBOARD              0
+#define C_MOUSE                 1
+#define C_SERIAL                2
+#define C_DEBUG                 3
+#define C_GROUPS                4       // Always keep after the listed groups
+#define C_HIDDEN                4       // Not listed by help or ?
+
+// Command types. Settings are read and written by cSetting(), C_CMD runs
+// the entry's handler.
+#define C_CMD                   0       // Command with its own handler
+#define C_ONOFF                 1       // 'max' bits of a byte, label is the on text, unit the off text
+#define C_BYTE                  2       // Decimal byte
+#define C_WORD                  3       // Decimal unsigned int
+#define C_HEX                   4       // Hex byte
+
+// Added to the address of a setting held in the selected profile
+#define C_PROFILE               0x80
+#define C_TIMING(field)         (C_PROFILE + offsetof(struct kb_profile, timings) + offsetof(struct kb_timings, field))
+#define C_FLAGS                 (C_PROFILE + offsetof(struct kb_profile, flags))
+
+static_assert(E_END_ADDRESS <= C_PROFILE, "EEPROM settings overlap C_PROFILE");
+static_assert(K_PROFILE_SIZE <= C_PROFILE, "Profile settings overflow the address byte");
+
+static bool cHelp(const String &param);
+static bool cSummary(const String &param);
+static bool cKbCaptureDump(const String &param);
+static bool cKbCaptureReplay(const String &param);
+static bool cKbModelList(const String &param);
+static bool cKbModelSave(const String &param);
+static bool cKbModelClear(const String &param);
+static bool cSerialReload(const String &param);
+static bool cCalcCrc(const String &param);
+static bool cSavedCrc(const String &param);
+static bool cEepromPrint(const String &param);
+static bool cEepromBatch(const String &param);
+static bool cEepromCommit(const String &param);
+static bool cStats(const String &param);
+static bool cMemory(const String &param);
+static bool cProfiler(const String &param);
+static bool cBench(const String &param);
+static bool cReset(const String &param);
+static bool cKbReload(const String &param);
 
 /*************************************************************************
- * Displays help text to the host serial port
+ * Command registry, one line per command or setting and in strcmp() order
+ * for the binary search in cFind().
+ *
+ * X(id, name, group, type, address, min, max, label, unit, help, handler)
+ *
+ * Settings need no code of their own. Their value is read from or written
+ * to the EEPROM 'address' by cSetting(), checked against 'min' to 'max',
+ * and printed with the 'label' and 'unit' texts. A setting's handler, if
+ * any, is called after the value is stored to apply it.
  *************************************************************************/
-void displayHelp()
+#define C_REGISTRY(X) \
+  X(summary,  "?",      C_HIDDEN,   C_CMD,   0,                             0, 0,          "",        "",        "",        cSummary)          \
+  X(bench,    "bench",  C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_24, cBench)            \
+  X(ccrc,     "ccrc",   C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_19, cCalcCrc)          \
+  X(eb,       "eb",     C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_38, cEepromBatch)      \
+  X(ec,       "ec",     C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_39, cEepromCommit)     \
+  X(ep,       "ep",     C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_21, cEepromPrint)      \
+  X(er,       "er",     C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_22, cEepromRead)       \
+  X(ew,       "ew",     C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_23, cEepromWrite)      \
+  X(help,     T_HELP,   C_HIDDEN,   C_CMD,   0,                             0, 0,          "",        "",        "",        cHelp)             \
+  X(k101,     "k101",   C_KEYBOARD, C_ONOFF, C_FLAGS,                       0, K_PF_EXT_101, T_MSG_08, T_MSG_09, T_HELP_04, cKbReload)        \
+  X(kabd,     "kabd",   C_KEYBOARD, C_BYTE,  C_TIMING(at_bit_delay),        0, 255,        T_MSG_10,  "",        T_HELP_05, cKbReload)         \
+  X(kand,     "kand",   C_KEYBOARD, C_BYTE,  C_TIMING(at_next_delay),       0, 255,        T_MSG_11,  "",        T_HELP_06, cKbReload)         \
+  X(kasd,     "kasd",   C_KEYBOARD, C_BYTE,  C_TIMING(at_start_delay),      0, 255,        T_MSG_12,  "",        T_HELP_07, cKbReload)         \
+  X(kbt,      "kbt",    C_KEYBOARD, C_WORD,  E_BOARD_TYPE,                  1, B_LAST - 1, T_MSG_06,  "",        T_HELP_03, NULL)              \
+  X(kcap,     "kcap",   C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_25, cKbCapture)        \
+  X(kcd,      "kcd",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_26, cKbCaptureDump)    \
+  X(kcr,      "kcr",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_27, cKbCaptureReplay)  \
+  X(kid,      "kid",    C_KEYBOARD, C_ONOFF, E_KB_ID,                       0, 0x01,       T_MSG_61,  T_MSG_62,  T_HELP_46, NULL)              \
+  X(kik,      "kik",    C_KEYBOARD, C_BYTE,  E_INJECT_DELAY,                0, 255,        T_MSG_67,  " mSec",   T_HELP_51, NULL)              \
+  X(kin,      "kin",    C_KEYBOARD, C_ONOFF, E_INJECT,                      0, 0x01,       T_MSG_65,  T_MSG_66,  T_HELP_50, NULL)              \
+  X(kls,      "kls",    C_KEYBOARD, C_ONOFF, E_LED_SHOW,                    0, 0x01,       T_MSG_44,  T_MSG_45,  T_HELP_31, NULL)              \
+  X(kmc,      "kmc",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_49, cKbModelClear)     \
+  X(kml,      "kml",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_47, cKbModelList)      \
+  X(kms,      "kms",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_48, cKbModelSave)      \
+  X(kp,       "kp",     C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_32, cKbProfile)        \
+  X(kpl,      "kpl",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_34, cKbProfileList)    \
+  X(kpn,      "kpn",    C_KEYBOARD, C_CMD,   0,                             0, 0,          "",        "",        T_HELP_33, cKbProfileName)    \
+  X(kxbd,     "kxbd",   C_KEYBOARD, C_BYTE,  C_TIMING(xt_bit_delay),        0, 255,        T_MSG_13,  "",        T_HELP_08, cKbReload)         \
+  X(kxnd,     "kxnd",   C_KEYBOARD, C_BYTE,  C_TIMING(xt_next_delay),       0, 255,        T_MSG_14,  "",        T_HELP_09, cKbReload)         \
+  X(kxr,      "kxr",    C_KEYBOARD, C_ONOFF, E_XT_RESET_KB,                 0, 0x01,       T_MSG_54,  T_MSG_55,  T_HELP_45, NULL)              \
+  X(kxsd,     "kxsd",   C_KEYBOARD, C_BYTE,  C_TIMING(xt_start_delay),      0, 255,        T_MSG_15,  "",        T_HELP_10, cKbReload)         \
+  X(mem,      "mem",    C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_37, cMemory)           \
+  X(men,      "men",    C_MOUSE,    C_ONOFF, E_MOUSE_ENABLED,               0, 0x01,       T_MSG_40,  T_MSG_41,  T_HELP_30, NULL)              \
+  X(prof,     "prof",   C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_35, cProfiler)         \
+  X(reset,    "reset",  C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_18, cReset)            \
+  X(sbr,      "sbr",    C_SERIAL,   C_CMD,   0,                             0, 0,          "",        "",        T_HELP_12, cSerialBaudRate)   \
+  X(scd,      "scd",    C_SERIAL,   C_WORD,  E_CHAR_DELAY,                  0, 0xFFFF,     T_MSG_19,  " mSec",   T_HELP_13, cSerialReload)     \
+  X(scrc,     "scrc",   C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_20, cSavedCrc)         \
+  X(sen,      "sen",    C_SERIAL,   C_ONOFF, E_SERIAL_ENABLED,              0, 0x01,       T_MSG_24,  T_MSG_25,  T_HELP_16, cSerialReload)     \
+  X(sfc,      "sfc",    C_SERIAL,   C_ONOFF, E_XON_XOFF,                    0, 0x01,       T_MSG_22,  T_MSG_23,  T_HELP_15, cSerialReload)     \
+  X(sld,      "sld",    C_SERIAL,   C_WORD,  E_LINE_DELAY,                  0, 0xFFFF,     T_MSG_21,  " mSec",   T_HELP_14, cSerialReload)     \
+  X(slm,      "slm",    C_SERIAL,   C_HEX,   E_LOG_MASK,                    0, 0xFF,       T_MSG_49,  "",        T_HELP_36, NULL)              \
+  X(stats,    "stats",  C_DEBUG,    C_CMD,   0,                             0, 0,          "",        "",        T_HELP_28, cStats)
+
+struct c_entry
+{
+  char name[6];
+  byte group;
+  byte type;
+  byte address;                 // EEPROM address, plus C_PROFILE if in the selected profile
+  unsigned int min;
+  unsigned int max;
+  const char *label;            // Flash strings
+  const char *unit;
+  const char *help;
+  bool (*handler)(const String &param);
+};
+
+// The texts of each entry in flash
+#define C_TEXTS(id, name, group, type, address, min, max, label, unit, help, handler) \
+  static const char c_label_##id[] PROGMEM = label; \
+  static const char c_unit_##id[] PROGMEM = unit; \
+  static const char c_help_##id[] PROGMEM = help;
+C_REGISTRY(C_TEXTS)
+
+#define C_ENTRY(id, name, group, type, address, min, max, label, unit, help, handler) \
+  { name, group, type, address, min, max, c_label_##id, c_unit_##id, c_help_##id, handler },
+static const struct c_entry c_registry[] PROGMEM =
 {
-  S_HOST.println("");
-  S_HOST.print(F("PS2KB Tool - v"));
-  S_HOST.println(VERSION);
-  S_HOST.println(F(T_HELP_01));
-  S_HOST.println(F(T_HELP_02));
-  S_HOST.println(F(T_HELP_03));
-  S_HOST.println(F(T_HELP_04));
-  S_HOST.println(F(T_HELP_05));
-  S_HOST.println(F(T_HELP_06));
-  S_HOST.println(F(T_HELP_07));
-  S_HOST.println(F(T_HELP_08));
-  S_HOST.println(F(T_HELP_09));
-  S_HOST.println(F(T_HELP_10));
-  S_HOST.println(F(T_HELP_11));
-  S_HOST.println(F(T_HELP_12));
-  S_HOST.println(F(T_HELP_13));
-  S_HOST.println(F(T_HELP_14));
-  S_HOST.println(F(T_HELP_15));
-  S_HOST.println(F(T_HELP_16));
-  S_HOST.println(F(T_HELP_17));
-  S_HOST.println(F(T_HELP_18));
-  S_HOST.println(F(T_HELP_19));
-  S_HOST.println(F(T_HELP_20));
-  S_HOST.println(F(T_HELP_21));
-  S_HOST.println(F(T_HELP_22));
-  S_HOST.println(F(T_HELP_23));
+  C_REGISTRY(C_ENTRY)
+};
+
+#define C_ENTRIES               (sizeof(c_registry) / sizeof(c_registry[0]))
+
+// Checks the registry is in order for cFind() when compiling
+#define C_NAME(id, name, group, type, address, min, max, label, unit, help, handler) name,
+static constexpr const char *c_names[] = { C_REGISTRY(C_NAME) };
+
+static constexpr bool cBefore(const char *a, const char *b)
+{
+  return *a != *b ? (unsigned char) *a < (unsigned char) *b : *a != 0 && cBefore(a + 1, b + 1);
 }
 
+static constexpr bool cSorted(const char * const *names, const size_t count)
+{
+  return count < 2 || (cBefore(names[0], names[1]) && cSorted(names + 1, count - 1));
+}
+
+static_assert(cSorted(c_names, sizeof(c_names) / sizeof(c_names[0])), "C_REGISTRY is not in strcmp() order");
+
+static const char c_group_0[] PROGMEM = T_HELP_02;
+static const char c_group_1[] PROGMEM = T_HELP_29;
+static const char c_group_2[] PROGMEM = T_HELP_11;
+static const char c_group_3[] PROGMEM = T_HELP_17;
+static const char * const c_group_headers[C_GROUPS] PROGMEM = { c_group_0, c_group_1, c_group_2, c_group_3 };
+
+static const char c_summary_0[] PROGMEM = T_HELP_40;
+static const char c_summary_1[] PROGMEM = T_HELP_44;
+static const char c_summary_2[] PROGMEM = T_HELP_41;
+static const char c_summary_3[] PROGMEM = T_HELP_42;
+static const char * const c_group_prefixes[C_GROUPS] PROGMEM = { c_summary_0, c_summary_1, c_summary_2, c_summary_3 };
+
 /*************************************************************************
- * Process the command line and calls the appropriate command function if
- * a valid command.
- * Returns true if command successful, otherwise false.
+ * Copies the registry entry for the command 'name' into 'entry'.
+ * Returns false if there is no such command.
  *************************************************************************/
-bool processCommand(const String cmdLine)
+static bool cFind(const char *name, struct c_entry &entry)
 {
-  String command = "";
-  String param = "";
+  int low = 0;
+  int high = C_ENTRIES - 1;
 
-  // Split the command line up into the command and parameters
-  int index = cmdLine.indexOf(" ");
-  if (index > 1)
-  {
-    command = cmdLine.substring(0, index);
-    param = cmdLine.substring(index + 1, cmdLine.length());
-  }
-  else
+  while (low <= high)
   {
-    command = cmdLine;
+    int mid = (low + high) / 2;
+    int order = strcmp_P(name, c_registry[mid].name);
+
+    if (order == 0)
+    {
+      memcpy_P(&entry, &c_registry[mid], sizeof(entry));
+      return true;
+    }
+    if (order < 0)
+    {
+      high = mid - 1;
+    }
+    else
+    {
+      low = mid + 1;
+    }
   }
-  
-  if (command.equals(T_HELP))
+  return false;
+}
+
+/*************************************************************************
+ * Prints a setting, or checks and stores 'param' as its new value.
+ * Returns true if successful, otherwise false.
+ *************************************************************************/
+static bool cSetting(const struct c_entry &entry, const String &param)
+{
+  int address = entry.address;
+  byte value = 0;
+  unsigned int word = 0;
+
+  if (address & C_PROFILE)
   {
-    displayHelp();
-    return true;
+    address = kProfileAddress(kGetProfile()) + (address & ~C_PROFILE);
   }
-  else if (command.equals("?"))
+
+  if (param.length() == 0)
   {
-    S_HOST.println(F(T_HELP_40));
-    S_HOST.println(F(T_HELP_41));
-    S_HOST.println(F(T_HELP_42));
-    S_HOST.println(F(T_HELP_43));
+    if (entry.type == C_ONOFF)
+    {
+      eGet(address, value);
+      sHostPrintln((const __FlashStringHelper *) ((value & entry.max) ? entry.label : entry.unit));
+      return true;
+    }
+
+    sHostPrint((const __FlashStringHelper *) entry.label);
+    if (entry.type == C_WORD)
+    {
+      sHostPrintNum(eGet(address, word), DEC);
+    }
+    else if (entry.type == C_HEX)
+    {
+      sHostPrintHex(eGet(address, value));
+    }
+    else
+    {
+      sHostPrintNum(eGet(address, value), DEC);
+    }
+    sHostPrintln((const __FlashStringHelper *) entry.unit);
     return true;
   }
-  // ************************* Keyboard Commands *********************************
-  else if (command.equals("kbt"))
-  {
-    return cKbBoardType(param);
-  }
-  else if (command.equals("k101"))
-  {
-    return cKb101(param);
-  }
-  else if (command.equals("kabd"))
-  {
-    return cKbTimings(param, 1);
-  }
-  else if (command.equals("kand"))
-  {
-    return cKbTimings(param, 2);
-  }
-  else if (command.equals("kasd"))
-  {
-    return cKbTimings(param, 3);
-  }
-  else if (command.equals("kxbd"))
-  {
-    return cKbTimings(param, 4);
-  }
-  else if (command.equals("kxnd"))
-  {
-    return cKbTimings(param, 5);
-  }
-  else if (command.equals("kxsd"))
-  {
-    return cKbTimings(param, 6);
-  }
-  // ************************* Serial Commands *********************************
-  else if (command.equals("sbr"))
-  {
-    return cSerialBaudRate(param);
-  }
-  else if (command.equals("scd"))
-  {
-    return cSerialCharDelay(param);
-  }
-  else if (command.equals("sld"))
-  {
-    return cSerialLineDelay(param);
-  }
-  else if (command.equals("sfc"))
+
+  if (entry.type == C_ONOFF)
   {
-    return cSerialFlowControl(param);
+    eGet(address, value);
+    if (param.equals(T_ON))
+    {
+      value |= entry.max;
+    }
+    else if (param.equals(T_OFF))
+    {
+      value &= ~entry.max;
+    }
+    else
+    {
+      sHostPrint(param);
+      sHostPrintln(F(T_IS_INVALID));
+      sHostPrintln(F(T_ON_OR_OFF));
+      return false;
+    }
+    ePut(address, value);
   }
-  else if (command.equals("sen"))
+  else
   {
-    return cSerialEnabled(param);
+    byte base = (entry.type == C_HEX) ? HEX : DEC;
+    char *end;
+    unsigned long number = strtoul(param.c_str(), &end, base);
+
+    if (*end != 0 || number < entry.min || number > entry.max)
+    {
+      sHostPrint(param);
+      sHostPrintln(F(T_IS_INVALID));
+      sHostPrint(F(T_MSG_57));
+      sHostPrintNum(entry.min, base);
+      sHostPrint(F(" - "));
+      sHostPrintNum(entry.max, base);
+      sHostPrintln();
+      return false;
+    }
+
+    if (entry.type == C_WORD)
+    {
+      ePut(address, (unsigned int) number);
+    }
+    else
+    {
+      ePut(address, (byte) number);
+    }
   }
-  // ************************* Debug Commands **********************************
-  else if (command.equals("ccrc"))
+  eUpdateCrc();
+
+  if (entry.handler != NULL)
   {
-    unsigned long crc_calc = eCrc();
-    S_HOST.println(T_MSG_01 + String(crc_calc, HEX));
-    return true;
+    return entry.handler(param);
   }
-  else if (command.equals("scrc"))
-  {
-    unsigned long crc_saved = 0;
-    EEPROM.get(E_CHECKSUM, crc_saved);
-    S_HOST.println(T_MSG_02 + String(crc_saved, HEX));
-    return true;
+  return true;
+}
+
+/*************************************************************************
+ * Displays help text to the host serial port
+ *************************************************************************/
+void displayHelp()
+{
+  struct c_entry entry;
+
+  sHostPrintln();
+  sHostPrint(F("PS2KB Tool - v"));
+  sHostPrintln(F(VERSION));
+  sHostPrintln(F(T_HELP_01));
+  for (byte group = 0; group < C_GROUPS; group++)
+  {
+    sHostPrintln((const __FlashStringHelper *) pgm_read_word(&c_group_headers[group]));
+    for (byte i = 0; i < C_ENTRIES; i++)
+    {
+      memcpy_P(&entry, &c_registry[i], sizeof(entry));
+      if (entry.group == group && !sHostPrintln((const __FlashStringHelper *) entry.help))
+      {
+        return;
+      }
+    }
   }
-  else if (command.equals("ep"))
+}
+
+/*************************************************************************
+ * Displays the command names of each group to the host serial port
+ *************************************************************************/
+void displaySummary()
+{
+  for (byte group = 0; group < C_GROUPS; group++)
   {
-    for (int i = 0; i < E_END_ADDRESS; i++)
+    bool first = true;
+
+    sHostPrint((const __FlashStringHelper *) pgm_read_word(&c_group_prefixes[group]));
+    for (byte i = 0; i < C_ENTRIES; i++)
     {
-      if (EEPROM.read(i) < 16)
+      if (pgm_read_byte(&c_registry[i].group) != group)
       {
-        S_HOST.print("0");
+        continue;
       }
-      S_HOST.print(String(EEPROM.read(i), HEX) + " ");
+      if (!first)
+      {
+        sHostPrint(',');
+      }
+      sHostPrint((const __FlashStringHelper *) c_registry[i].name);
+      first = false;
     }
-    S_HOST.println("");
-    return true;
+    sHostPrintln();
   }
-  else if (command.equals("er"))
+  sHostPrintln(F(T_HELP_43));
+}
+
+/*************************************************************************
+ * Process the command line and calls the appropriate command function if
+ * a valid command.
+ * Returns true if command successful, otherwise false.
+ *************************************************************************/
+bool processCommand(const String cmdLine)
+{
+  String command = "";
+  String param = "";
+  struct c_entry entry;
+
+  // Split the command line up into the command and parameters
+  int index = cmdLine.indexOf(" ");
+  if (index > 1)
   {
-    return cEepromRead(param);
+    command = cmdLine.substring(0, index);
+    param = cmdLine.substring(index + 1, cmdLine.length());
   }
-  else if (command.equals("ew"))
+  else
   {
-    return cEepromWrite(param);
+    command = cmdLine;
   }
-  else if (command.equals("reset"))
+
+  if (cFind(command.c_str(), entry))
   {
-    asm volatile ("  jmp 0"); 
-    return true;
+    if (entry.type == C_CMD)
+    {
+      return entry.handler(param);
+    }
+    return cSetting(entry, param);
   }
 
-  S_HOST.println("");
-  S_HOST.println(T_MSG_03);
-  S_HOST.println(F(T_MSG_04));
+  sHostPrintln();
+  sHostPrint(F(T_MSG_03));
+  sHostPrint(command);
+  sHostPrintln(F(T_MSG_30));
+  sHostPrintln(F(T_MSG_04));
   return false;
 }
 
@@ -198,272 +416,347 @@ bool processCommand(const String cmdLine)
  *************************************************************************/
 void sHostPrompt()
 {
-  S_HOST.print(">");
+  sHostPrint('>');
 }
 
 /*************************************************************************
  * Commands.
  *************************************************************************/
 //*************************************************************************
+static bool cHelp(const String &param)
+{
+  displayHelp();
+  return true;
+}
+
 //*************************************************************************
-bool cKbBoardType(const String param)
+static bool cSummary(const String &param)
 {
-  if (param.length() > 0)
-  {
-    if ((param.toInt() < 1) | (param.toInt() >= B_LAST))
-    {
-      S_HOST.println(F(T_MSG_05));
-      return false;
-    }
-    else
-    {
-      kBoardType(param.toInt());
-      return true;
-    }
-  }
-  else
-  {
-    S_HOST.println(T_MSG_06 + String(kGetBoardType(), DEC));
-    return true;
-  }
+  displaySummary();
+  return true;
 }
 
-bool cKb101(const String param)
+//*************************************************************************
+bool cKbCapture(const String &param)
 {
   if (param.length() > 0)
   {
     if (param.equals(T_ON))
     {
-      k101Enabled(true);
+      capEnabled(true);
     }
     else
     {
       if (param.equals(T_OFF))
       {
-        k101Enabled(false);
+        capEnabled(false);
       }
       else
       {
-        S_HOST.println(param + T_IS_INVALID);
-        S_HOST.println(F(T_ON_OR_OFF));
+        sHostPrint(param);
+        sHostPrintln(F(T_IS_INVALID));
+        sHostPrintln(F(T_ON_OR_OFF));
         return false;
       }
     }
   }
   else
   {
-    if (kGet101Enabled())
+    if (capGetEnabled())
     {
-      S_HOST.println(F(T_MSG_08));
+      sHostPrintln(F(T_MSG_31));
     }
     else
     {
-      S_HOST.println(F(T_MSG_09));
+      sHostPrintln(F(T_MSG_32));
     }
+    sHostPrint(F(T_MSG_33));
+    sHostPrintNum(capCount(), DEC);
+    sHostPrintln();
     return true;
   }
-  return false; // We should never get here.
+  return true;
 }
 
-bool cKbTimings(const String param, byte item)
+//*************************************************************************
+static bool cKbCaptureDump(const String &param)
 {
-  if (param.length() > 0)
-  {
-    kDelayTimings(param.toInt(), item);
-  }
-  else
-  {
-    switch(item)
-    {
-      case 1:
-        S_HOST.println(T_MSG_10 + String(kGetDelayTimings(item), DEC));
-        break;
-      case 2:
-        S_HOST.println(T_MSG_11 + String(kGetDelayTimings(item), DEC));
-        break;
-      case 3:
-        S_HOST.println(T_MSG_12 + String(kGetDelayTimings(item), DEC));
-        break;
-      case 4:
-        S_HOST.println(T_MSG_13 + String(kGetDelayTimings(item), DEC));
-        break;
-      case 5:
-        S_HOST.println(T_MSG_14 + String(kGetDelayTimings(item), DEC));
-        break;
-      case 6:
-        S_HOST.println(T_MSG_15 + String(kGetDelayTimings(item), DEC));
-        break;
-      default:
-        return false; // We should never get here.
-        break;
-    }
-  }
+  capPrint();
+  return true;
+}
+
+//*************************************************************************
+// Applies a change to the selected profile's timings or flags to the bench
+// and capture replay, which use the values in RAM
+static bool cKbReload(const String &param)
+{
+  kLoadProfile();
+  return true;
+}
+
+//*************************************************************************
+static bool cKbCaptureReplay(const String &param)
+{
+  capReplay();
   return true;
 }
 
 //*************************************************************************
-bool cSerialBaudRate(const String param)
+bool cKbProfile(const String &param)
 {
   if (param.length() > 0)
   {
-    if (sHostBaudRate(param.toInt()))
+    if (param.length() != 1 || param.charAt(0) < '0' || param.charAt(0) >= '0' + K_PROFILES)
     {
-      S_HOST.end();
-      S_HOST.begin(sHostGetBaudRate());
-      return true;
-    }
-    else
-    {
-      S_HOST.println(F(T_MSG_16));
+      sHostPrint(param);
+      sHostPrintln(F(T_IS_INVALID));
+      sHostPrintln(F(T_MSG_47));
       return false;
     }
+    kProfile(param.toInt());
+    kLoadProfile();
   }
   else
   {
-    S_HOST.println(T_MSG_17 + String(sHostGetBaudRate(), DEC) + " bps");
-    return true;
+    struct kb_profile data;
+    byte profile = kGetProfile();
+
+    kGetProfileData(profile, data);
+    sHostPrint(F(T_MSG_46));
+    sHostPrintNum(profile, DEC);
+    sHostPrint(' ');
+    cPrintProfileName(data);
+    sHostPrintln();
   }
+  return true;
 }
 
 //*************************************************************************
-bool cSerialCharDelay(const String param)
+bool cKbProfileName(const String &param)
 {
-  if (param.length() > 0)
+  if (param.length() == 0 || param.length() > K_PROFILE_NAME)
   {
-    if (param.toInt() < 0)
+    sHostPrint(param);
+    sHostPrintln(F(T_IS_INVALID));
+    return false;
+  }
+  kProfileName(param);
+  return true;
+}
+
+//*************************************************************************
+bool cKbProfileList(const String &param)
+{
+  struct kb_profile data;
+  byte selected = kGetProfile();
+
+  for (byte profile = 0; profile < K_PROFILES; profile++)
+  {
+    kGetProfileData(profile, data);
+    sHostPrint(profile == selected ? '*' : ' ');
+    sHostPrintNum(profile, DEC);
+    sHostPrint(' ');
+    cPrintProfileName(data);
+    sHostPrint(F(" abd="));
+    sHostPrintNum(data.timings.at_bit_delay, DEC);
+    sHostPrint(F(" and="));
+    sHostPrintNum(data.timings.at_next_delay, DEC);
+    sHostPrint(F(" asd="));
+    sHostPrintNum(data.timings.at_start_delay, DEC);
+    sHostPrint(F(" xbd="));
+    sHostPrintNum(data.timings.xt_bit_delay, DEC);
+    sHostPrint(F(" xnd="));
+    sHostPrintNum(data.timings.xt_next_delay, DEC);
+    sHostPrint(F(" xsd="));
+    sHostPrintNum(data.timings.xt_start_delay, DEC);
+    sHostPrint(F(" k101="));
+    if (data.flags & K_PF_EXT_101)
     {
-      S_HOST.println(F(T_MSG_18));
-      return false;
+      sHostPrintln(F(T_ON));
     }
     else
     {
-      sHostCharDelay(param.toInt());
-      return true;
+      sHostPrintln(F(T_OFF));
     }
   }
-  else
-  {
-    S_HOST.println(T_MSG_19 + String(sHostGetCharDelay(), DEC) + " mSec");
-    return true;
-  }
+  return true;
 }
 
 //*************************************************************************
-bool cSerialLineDelay(const String param)
+static bool cKbModelList(const String &param)
 {
-  if (param.length() > 0)
+  struct kb_model model;
+  unsigned int id;
+  byte clock;
+
+  for (byte index = 0; index < K_MODELS; index++)
   {
-    if (param.toInt() < 0)
-    {
-      S_HOST.println(F(T_MSG_20));
-      return false;
-    }
-    else
+    kGetModel(index, model);
+    sHostPrintNum(index, DEC);
+    if (model.id == K_NO_MODEL)
     {
-      sHostLineDelay(param.toInt());
-      return true;
+      sHostPrintln(F(" -"));
+      continue;
     }
+    sHostPrint(F(" id="));
+    sHostPrintNum(model.id, HEX);
+    sHostPrint(F(" clk="));
+    sHostPrintNum(model.clock, DEC);
+    sHostPrint(F(" abd="));
+    sHostPrintNum(model.at_bit_delay, DEC);
+    sHostPrint(F(" and="));
+    sHostPrintNum(model.at_next_delay, DEC);
+    sHostPrint(F(" asd="));
+    sHostPrintNum(model.at_start_delay, DEC);
+    sHostPrintln();
+  }
+
+  sHostPrint(F(T_MSG_58));
+  if (stGetKbId(id, clock))
+  {
+    sHostPrintNum(id, HEX);
+    sHostPrint(F(", "));
+    sHostPrintNum(clock, DEC);
+    sHostPrintln(F(" uSec"));
   }
   else
   {
-    S_HOST.println(T_MSG_21 + String(sHostGetLineDelay(), DEC) + " mSec");
-    return true;
+    sHostPrintln(F(T_MSG_60));
   }
+  return true;
 }
 
 //*************************************************************************
-bool cSerialFlowControl(const String param)
+static bool cKbModelSave(const String &param)
 {
-  if (param.length() > 0)
+  struct kb_model model;
+  struct kb_profile data;
+
+  if (!stGetKbId(model.id, model.clock))
   {
-    if (param.equals(T_ON))
-    {
-      sHostXonXoff(true);
-    }
-    else
-    {
-      if (param.equals(T_OFF))
-      {
-        sHostXonXoff(false);
-      }
-      else
-      {
-        S_HOST.println(param + T_IS_INVALID);
-        S_HOST.println(F(T_ON_OR_OFF));
-        return false;
-      }
-    }
+    sHostPrintln(F(T_MSG_63));
+    return false;
   }
-  else
+
+  // The AT timings of the selected profile are proven for this keyboard
+  kGetProfileData(kGetProfile(), data);
+  model.at_bit_delay = data.timings.at_bit_delay;
+  model.at_next_delay = data.timings.at_next_delay;
+  model.at_start_delay = data.timings.at_start_delay;
+  if (!kSaveModel(model))
+  {
+    sHostPrintln(F(T_MSG_64));
+    return false;
+  }
+  return true;
+}
+
+//*************************************************************************
+static bool cKbModelClear(const String &param)
+{
+  kResetModels();
+  eUpdateCrc();
+  return true;
+}
+
+//*************************************************************************
+void cPrintProfileName(const struct kb_profile &data)
+{
+  // Names that fill the field are not null terminated
+  for (byte i = 0; i < K_PROFILE_NAME && data.name[i] != 0; i++)
   {
-    if (sHostGetXonXoff())
-    {
-      S_HOST.println(F(T_MSG_22));
-    }
-    else
-    {
-      S_HOST.println(F(T_MSG_23));
-    }
-    return true;
+    sHostPrint(data.name[i]);
   }
-  return false; // We should never get here.
 }
 
 //*************************************************************************
-bool cSerialEnabled(const String param)
+bool cSerialBaudRate(const String &param)
 {
   if (param.length() > 0)
   {
-    if (param.equals(T_ON))
+    if (sHostBaudRate(param.toInt()))
     {
-      sHostEnabled(true);
+      S_HOST.end();
+      S_HOST.begin(sHostGetBaudRate());
+      return true;
     }
     else
     {
-      if (param.equals(T_OFF))
-      {
-        sHostEnabled(false);
-      }
-      else
-      {
-        S_HOST.println(param + T_IS_INVALID);
-        S_HOST.println(F(T_ON_OR_OFF));
-        return false;
-      }
+      sHostPrintln(F(T_MSG_16));
+      return false;
     }
   }
   else
   {
-    if (sHostGetEnabled())
-    {
-      S_HOST.println(F(T_MSG_24));
-    }
-    else
-    {
-      S_HOST.println(F(T_MSG_25));
-    }
+    sHostPrint(F(T_MSG_17));
+    sHostPrintNum(sHostGetBaudRate(), DEC);
+    sHostPrintln(F(" bps"));
     return true;
   }
-  return false; // We should never get here.
 }
 
 //*************************************************************************
-bool cEepromRead(const String param)
+// Applies a changed serial setting, the getters reload it from the EEPROM
+static bool cSerialReload(const String &param)
+{
+  sHostGetCharDelay();
+  sHostGetLineDelay();
+  sHostGetXonXoff();
+  sHostGetEnabled();
+  return true;
+}
+
+//*************************************************************************
+static bool cCalcCrc(const String &param)
+{
+  unsigned long crc_calc = eCrc();
+
+  sHostPrint(F(T_MSG_01));
+  sHostPrintNum(crc_calc, HEX);
+  sHostPrintln();
+  return true;
+}
+
+//*************************************************************************
+static bool cSavedCrc(const String &param)
+{
+  unsigned long crc_saved = 0;
+
+  eGet(E_CHECKSUM, crc_saved);
+  sHostPrint(F(T_MSG_02));
+  sHostPrintNum(crc_saved, HEX);
+  sHostPrintln();
+  return true;
+}
+
+//*************************************************************************
+static bool cEepromPrint(const String &param)
+{
+  ePrintValues();
+  return true;
+}
+
+//*************************************************************************
+bool cEepromRead(const String &param)
 {
   if (param.length() > 0)
   {
-    S_HOST.println(T_MSG_26 + param + " = " + String(EEPROM.read(param.toInt()), HEX));
+    sHostPrint(F(T_MSG_26));
+    sHostPrint(param);
+    sHostPrint(F(" = "));
+    sHostPrintNum(eRead(param.toInt()), HEX);
+    sHostPrintln();
     return true;
   }
   else
   {
-    S_HOST.println(F(T_MSG_27));
+    sHostPrintln(F(T_MSG_27));
     return false;
   }
 }
 
 //*************************************************************************
-bool cEepromWrite(const String param)
+bool cEepromWrite(const String &param)
 {
   if (param.length() > 0)
   {
@@ -472,19 +765,79 @@ bool cEepromWrite(const String param)
     {
       String address = param.substring(0, index);
       String value = param.substring(index + 1, param.length());
-      S_HOST.println(T_MSG_28 + address + " = " + value);
-      EEPROM.write(address.toInt(), value.toInt());
+      sHostPrint(F(T_MSG_28));
+      sHostPrint(address);
+      sHostPrint(F(" = "));
+      sHostPrintln(value);
+      eWrite(address.toInt(), value.toInt());
       return true;
     }
     else
     {
-      S_HOST.println(F(T_MSG_29));
+      sHostPrintln(F(T_MSG_29));
       return false;
     }
   }
   else
   {
-    S_HOST.println(F(T_MSG_27));
+    sHostPrintln(F(T_MSG_27));
+    return false;
+  }
+}
+
+//*************************************************************************
+static bool cEepromBatch(const String &param)
+{
+  if (!eBatch())
+  {
+    sHostPrintln(F(T_MSG_68));
     return false;
   }
+  return true;
+}
+
+//*************************************************************************
+static bool cEepromCommit(const String &param)
+{
+  eCommit();
+  return true;
+}
+
+//*************************************************************************
+static bool cStats(const String &param)
+{
+  stPrint();
+  wdPrint();
+  schPrint();
+  return true;
+}
+
+//*************************************************************************
+static bool cMemory(const String &param)
+{
+  memPrint();
+  return true;
+}
+
+//*************************************************************************
+static bool cProfiler(const String &param)
+{
+  pfPrint();
+  pfClear();
+  return true;
+}
+
+//*************************************************************************
+static bool cBench(const String &param)
+{
+  return bRun();
+}
+
+//*************************************************************************
+static bool cReset(const String &param)
+{
+  // Don't lose the changes of an open batch
+  eCommit();
+  asm volatile ("  jmp 0"); 
+  return true;
 }
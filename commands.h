@@ -18,19 +18,19 @@
  */
 
 void displayHelp();
+void displaySummary();
 bool processCommand(const String cmdLine);
 void sHostPrompt();
 
-bool cKb101(const String param);
-bool cKbBoardType(const String param);
-bool cKbTimings(const String param, byte item);
-bool cSerialBaudRate(const String param);
-bool cSerialCharDelay(const String param);
-bool cSerialLineDelay(const String param);
-bool cSerialFlowControl(const String param);
-bool cSerialEnabled(const String param);
+bool cKbCapture(const String &param);
+bool cKbProfile(const String &param);
+bool cKbProfileName(const String &param);
+bool cKbProfileList(const String &param);
+bool cSerialBaudRate(const String &param);
 
-bool cEepromRead(const String param);
-bool cEepromWrite(const String param);
+bool cEepromRead(const String &param);
+bool cEepromWrite(const String &param);
+
+void cPrintProfileName(const struct kb_profile &data);
 
 #endif // _COMMANDS_H_
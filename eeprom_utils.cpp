@@ -20,8 +20,14 @@
 #include "globals.h"
 
 #include "eeprom_utils.h"
+#include "keyboard.h"
+#include "profile.h"
 #include "serial_utils.h"
 
+// Only allocated while a batch is open so that it takes no RAM otherwise
+static bool e_batch = false;
+static byte *e_shadow = NULL;
+
 //*************************************************************************
 unsigned long eCrc(void)
 {
@@ -37,8 +43,8 @@ unsigned long eCrc(void)
 
   for (int index = E_SIGNATURE ; index < E_END_ADDRESS  ; ++index)
   {
-    crc = crc_table[(crc ^ EEPROM[index]) & 0x0f] ^ (crc >> 4);
-    crc = crc_table[(crc ^ (EEPROM[index] >> 4)) & 0x0f] ^ (crc >> 4);
+    crc = crc_table[(crc ^ eRead(index)) & 0x0f] ^ (crc >> 4);
+    crc = crc_table[(crc ^ (eRead(index) >> 4)) & 0x0f] ^ (crc >> 4);
     crc = ~crc;
   }
   return crc;
@@ -47,12 +53,12 @@ unsigned long eCrc(void)
 //*************************************************************************
 void eInit()
 {
-  if (EEPROM.read(E_SIGNATURE) == 0x55 && EEPROM.read(E_SIGNATURE + 1) == 0xAA)
+  if (eRead(E_SIGNATURE) == 0x55 && eRead(E_SIGNATURE + 1) == 0xAA)
   {
     unsigned long crc_calc = eCrc();
     unsigned long crc_saved = 0;
 
-    EEPROM.get(E_CHECKSUM, crc_saved);
+    eGet(E_CHECKSUM, crc_saved);
     if (crc_calc != crc_saved)
     {
       eResetDefaultValues();
@@ -69,13 +75,10 @@ void ePrintValues()
 {
   for (int i = 0; i < E_END_ADDRESS; i++)
   {
-    if (EEPROM.read(i) < 16)
-    {
-      S_HOST.print("0");
-    }
-    S_HOST.print(String(EEPROM.read(i), HEX) + " ");
+    sHostPrintHex(eRead(i));
+    sHostPrint(' ');
   }
-  S_HOST.println("");
+  sHostPrintln();
 }
 
 //*************************************************************************
@@ -85,22 +88,25 @@ void eResetDefaultValues()
 
   ePrintValues();
 
-  EEPROM.put(E_SIGNATURE, (unsigned int) 0xAA55);
-  EEPROM.put(E_VERSION, (unsigned int) 0x0001);
-  EEPROM.put(E_SIZE, (unsigned int) (E_END_ADDRESS - 4));
-  EEPROM.put(E_HOST_BAUD, (unsigned long) S_DEF_HOST_BAUD);
-  EEPROM.put(E_CHAR_DELAY, (unsigned int) S_DEF_CHAR_DELAY);
-  EEPROM.put(E_LINE_DELAY, (unsigned int) S_DEF_LINE_DELAY);
-  EEPROM.put(E_XON_XOFF, (byte) S_DEF_XON_XOFF);
-  EEPROM.put(E_SERIAL_ENABLED, (byte) S_DEF_SERIAL_ENABLED);
-  EEPROM.put(E_EXT_KEYS_ENABLED, (byte) K_DEF_EXT_KEYS_ENABLED);
-  EEPROM.put(E_BOARD_TYPE, (unsigned int) K_DEF_BOARD_TYPE);
-  EEPROM.put(E_AT_BIT_DELAY, (byte) K_DEF_AT_BIT_DELAY);
-  EEPROM.put(E_AT_NEXT_DELAY, (byte) K_DEF_AT_NEXT_DELAY);
-  EEPROM.put(E_AT_START_DELAY, (byte) K_DEF_AT_START_DELAY);
-  EEPROM.put(E_XT_BIT_DELAY, (byte) K_DEF_XT_BIT_DELAY);
-  EEPROM.put(E_XT_NEXT_DELAY, (byte) K_DEF_XT_NEXT_DELAY);
-  EEPROM.put(E_XT_START_DELAY, (byte) K_DEF_XT_START_DELAY);
+  ePut(E_SIGNATURE, (unsigned int) 0xAA55);
+  ePut(E_VERSION, (unsigned int) 0x0002);
+  ePut(E_SIZE, (unsigned int) (E_END_ADDRESS - 4));
+  ePut(E_HOST_BAUD, (unsigned long) S_DEF_HOST_BAUD);
+  ePut(E_CHAR_DELAY, (unsigned int) S_DEF_CHAR_DELAY);
+  ePut(E_LINE_DELAY, (unsigned int) S_DEF_LINE_DELAY);
+  ePut(E_XON_XOFF, (byte) S_DEF_XON_XOFF);
+  ePut(E_SERIAL_ENABLED, (byte) S_DEF_SERIAL_ENABLED);
+  ePut(E_BOARD_TYPE, (unsigned int) K_DEF_BOARD_TYPE);
+  ePut(E_CAPTURE_ENABLED, (byte) K_DEF_CAPTURE_ENABLED);
+  ePut(E_MOUSE_ENABLED, (byte) M_DEF_MOUSE_ENABLED);
+  ePut(E_LED_SHOW, (byte) K_DEF_LED_SHOW);
+  ePut(E_LOG_MASK, (byte) S_DEF_LOG_MASK);
+  ePut(E_XT_RESET_KB, (byte) K_DEF_XT_RESET_KB);
+  ePut(E_KB_ID, (byte) K_DEF_KB_ID);
+  ePut(E_INJECT, (byte) K_DEF_INJECT);
+  ePut(E_INJECT_DELAY, (byte) K_DEF_INJECT_DELAY);
+  kResetProfiles();
+  kResetModels();
   eUpdateCrc();
 
   ePrintValues();
@@ -111,6 +117,88 @@ void eUpdateCrc()
 {
   unsigned long crc_calc = 0;
 
+  // The CRC is written once by eCommit() at the end of a batch
+  if (e_batch)
+  {
+    return;
+  }
+
+  PF_STATE(PF_ST_EEPROM);
+
   crc_calc = eCrc();
-  EEPROM.put(E_CHECKSUM, (unsigned long) crc_calc);
+  ePut(E_CHECKSUM, (unsigned long) crc_calc);
+}
+
+//*************************************************************************
+byte eRead(const int address)
+{
+  if (e_batch && address < E_END_ADDRESS)
+  {
+    return e_shadow[address];
+  }
+  return EEPROM.read(address);
+}
+
+//*************************************************************************
+void eWrite(const int address, const byte value)
+{
+  if (e_batch && address < E_END_ADDRESS)
+  {
+    e_shadow[address] = value;
+    return;
+  }
+
+  if (EEPROM.read(address) != value)
+  {
+    PF_STATE(PF_ST_EEPROM);
+
+    // Each byte takes about 3.4 mSecs to write, long enough for pasted
+    // input to overrun the UART receive buffer if it is not read
+    while (!eeprom_is_ready())
+    {
+      sHostPoll();
+    }
+    EEPROM.write(address, value);
+  }
+}
+
+//*************************************************************************
+bool eBatch()
+{
+  if (!e_batch)
+  {
+    e_shadow = (byte *) malloc(E_END_ADDRESS);
+    if (e_shadow == NULL)
+    {
+      return false;
+    }
+    for (int i = 0; i < E_END_ADDRESS; i++)
+    {
+      e_shadow[i] = EEPROM.read(i);
+    }
+    e_batch = true;
+  }
+  return true;
+}
+
+//*************************************************************************
+void eCommit()
+{
+  if (e_batch)
+  {
+    e_batch = false;
+    for (int i = 0; i < E_END_ADDRESS; i++)
+    {
+      eWrite(i, e_shadow[i]);
+    }
+    free(e_shadow);
+    e_shadow = NULL;
+    eUpdateCrc();
+  }
+}
+
+//*************************************************************************
+bool eInBatch()
+{
+  return e_batch;
 }
@@ -23,4 +23,58 @@ void ePrintValues();
 void eResetDefaultValues();
 void eUpdateCrc();
 
+/*************************************************************************
+ * eRead / eWrite
+ * 
+ * Read and write a byte of the settings. While a batch is open the
+ * settings are held in RAM and only written to the EEPROM by eCommit().
+ * Otherwise eWrite() only writes a byte that has changed and polls the
+ * host serial input while waiting for the previous write to complete.
+ *************************************************************************/
+byte eRead(const int address);
+void eWrite(const int address, const byte value);
+
+/*************************************************************************
+ * eGet / ePut
+ * 
+ * EEPROM.get() and EEPROM.put() equivalents that go through eRead() and
+ * eWrite().
+ *************************************************************************/
+template <typename T> T &eGet(const int address, T &value)
+{
+  byte *p = (byte *) &value;
+
+  for (unsigned int i = 0; i < sizeof(T); i++)
+  {
+    p[i] = eRead(address + i);
+  }
+  return value;
+}
+
+template <typename T> const T &ePut(const int address, const T &value)
+{
+  const byte *p = (const byte *) &value;
+
+  for (unsigned int i = 0; i < sizeof(T); i++)
+  {
+    eWrite(address + i, p[i]);
+  }
+  return value;
+}
+
+/*************************************************************************
+ * eBatch / eCommit
+ * 
+ * eBatch() opens a batch so that a run of setting changes, e.g. from a
+ * pasted configuration script, are made in RAM without any EEPROM writes
+ * or CRC updates. eCommit() writes the changed bytes and the new CRC and
+ * closes the batch. eInBatch() returns true while a batch is open.
+ * 
+ * The RAM copy is taken from the heap when the batch is opened and freed
+ * by eCommit(). eBatch() returns false if there is not enough free.
+ *************************************************************************/
+bool eBatch();
+void eCommit();
+bool eInBatch();
+
 #endif // _EEPROM_UTILS_H_
@@ -48,17 +48,41 @@
 #define T_HELP_21           "ep                    - print all EEPROM values"
 #define T_HELP_22           "er <address>          - read value from EEPROM address"
 #define T_HELP_23           "ew <address> <value>  - write value to EEPROM address"
+#define T_HELP_24           "bench                 - run hot path benchmarks and rollover stress"
+#define T_HELP_25           "kcap <on|off>         - set AT frame capture"
+#define T_HELP_26           "kcd                   - dump captured AT frames"
+#define T_HELP_27           "kcr                   - replay captured AT frames"
+#define T_HELP_28           "stats                 - show statistics from the last run"
+#define T_HELP_29           "--Mouse--"
+#define T_HELP_30           "men <on|off>          - set PS/2 to serial mouse"
+#define T_HELP_31           "kls <on|off>          - set boot keyboard LED cycle"
+#define T_HELP_32           "kp <0-3>              - select timing profile to use and edit"
+#define T_HELP_33           "kpn <name>            - set name of the selected profile"
+#define T_HELP_34           "kpl                   - list timing profiles"
+#define T_HELP_35           "prof                  - show and clear profiler results"
+#define T_HELP_36           "slm <hex mask>        - set serial debug log categories"
+#define T_HELP_37           "mem                   - show free RAM and peak stack and heap use"
+#define T_HELP_38           "eb                    - start a batch of setting changes"
+#define T_HELP_39           "ec                    - write a batch of setting changes to EEPROM"
 
-#define T_HELP_40           "Keyboard: kbt,k101,kabd,kand,kasd,kxbd,kxnd,kxsd"
-#define T_HELP_41           "Serial  : sbr,scd,sld,sfc,sen"
-#define T_HELP_42           "Debug   : reset,ccrc,scrc,ep,er,ew"
+#define T_HELP_40           "Keyboard: "
+#define T_HELP_41           "Serial  : "
+#define T_HELP_42           "Debug   : "
 #define T_HELP_43           "type 'help' for more detailed help"
+#define T_HELP_44           "Mouse   : "
+#define T_HELP_45           "kxr <on|off>          - set XT host reset also resets the keyboard"
+#define T_HELP_46           "kid <on|off>          - set identify keyboard and use its model timings"
+#define T_HELP_47           "kml                   - list keyboard model timings"
+#define T_HELP_48           "kms                   - save profile AT timings for the last keyboard identified"
+#define T_HELP_49           "kmc                   - clear keyboard model timings"
+#define T_HELP_50           "kin <on|off>          - set typing of serial port text into the XT host"
+#define T_HELP_51           "kik <mSec>            - set delay between keys typed from the serial port"
 
 #define T_MSG_01            "Calculated CRC = "
 #define T_MSG_02            "Saved CRC = "
-#define T_MSG_03            "command '" + command + "' not found"
+#define T_MSG_03            "command '"
 #define T_MSG_04            "Type 'help' for a list of commands"
-#define T_MSG_05            "Invalid board type"
+//#define T_MSG_05            ""
 #define T_MSG_06            "Board type = "
 //#define T_MSG_07            ""
 #define T_MSG_08            "101 keys is enabled"
@@ -71,9 +95,9 @@
 #define T_MSG_15            "XT Start Bit Delay = "
 #define T_MSG_16            "Host baud rate not valid"
 #define T_MSG_17            "Baud rate = "
-#define T_MSG_18            "Inter character delay too small"
+//#define T_MSG_18            ""
 #define T_MSG_19            "Inter character delay = "
-#define T_MSG_20            "Inter line delay too small"
+//#define T_MSG_20            ""
 #define T_MSG_21            "Inter line delay = "
 #define T_MSG_22            "Xon/Xoff flow control is enabled"
 #define T_MSG_23            "Xon/Xoff flow control is disabled"
@@ -83,5 +107,44 @@
 #define T_MSG_27            "EEPROM address not specified"
 #define T_MSG_28            "Writing to EEPROM Address "
 #define T_MSG_29            "EEPROM value not specified"
+#define T_MSG_30            "' not found"
+#define T_MSG_31            "AT frame capture is enabled"
+#define T_MSG_32            "AT frame capture is disabled"
+#define T_MSG_33            "Captured frames = "
+#define T_MSG_34            "Time asleep = "
+#define T_MSG_35            "AT parity errors = "
+#define T_MSG_36            "AT stop bit errors = "
+#define T_MSG_37            "AT frame timeouts = "
+#define T_MSG_38            "AT late samples = "
+#define T_MSG_39            "AT clock period = "
+#define T_MSG_40            "PS/2 to serial mouse is enabled"
+#define T_MSG_41            "PS/2 to serial mouse is disabled"
+#define T_MSG_42            "Boot time = "
+#define T_MSG_43            "Reset to first key = "
+#define T_MSG_44            "Boot LED cycle is enabled"
+#define T_MSG_45            "Boot LED cycle is disabled"
+#define T_MSG_46            "Profile = "
+#define T_MSG_47            "Invalid profile"
+#define T_MSG_48            "Profiler not built in, see PROFILE and PROFILE_SAMPLER in globals.h"
+#define T_MSG_49            "Log mask = "
+#define T_MSG_50            "Command queue full, line dropped"
+#define T_MSG_51            "Watchdog resets = "
+#define T_MSG_52            "Last hang = "
+#define T_MSG_53            "Watchdog reset, last hang = "
+#define T_MSG_54            "XT host reset also resets the keyboard"
+#define T_MSG_55            "XT host reset does not reset the keyboard"
+#define T_MSG_56            "XT host resets = "
+#define T_MSG_57            "Valid range is "
+#define T_MSG_58            "Keyboard ID = "
+#define T_MSG_59            "Keyboard model = "
+#define T_MSG_60            "none"
+#define T_MSG_61            "Keyboard identification is enabled"
+#define T_MSG_62            "Keyboard identification is disabled"
+#define T_MSG_63            "No keyboard identified in the last run"
+#define T_MSG_64            "Keyboard model timings are full, clear them with kmc"
+#define T_MSG_65            "Serial keystroke injection is enabled"
+#define T_MSG_66            "Serial keystroke injection is disabled"
+#define T_MSG_67            "Injected key delay = "
+#define T_MSG_68            "Not enough memory to open a batch"
 
 #endif // _ENGLISH_H_
@@ -48,17 +48,41 @@
 #define T_HELP_21           "ep                    - Alle EEPROM Werte drucken"
 #define T_HELP_22           "er <Adresse>          - Wert aus EEPROM adresse lesen"
 #define T_HELP_23           "ew <Adresse> <Wert>   - Wert an EEPROM adresse schreiben"
+#define T_HELP_24           "bench                 - Hot path benchmarks und rollover test ausführen"
+#define T_HELP_25           "kcap <ein|aus>        - AT rahmenaufzeichnung einstellen"
+#define T_HELP_26           "kcd                   - aufgezeichnete AT rahmen ausgeben"
+#define T_HELP_27           "kcr                   - aufgezeichnete AT rahmen abspielen"
+#define T_HELP_28           "stats                 - Statistik des letzten laufs anzeigen"
+#define T_HELP_29           "--Maus--"
+#define T_HELP_30           "men <ein|aus>         - PS/2 zu serieller maus einstellen"
+#define T_HELP_31           "kls <ein|aus>         - tastatur LED zyklus beim start einstellen"
+#define T_HELP_32           "kp <0-3>              - zeitprofil auswählen und bearbeiten"
+#define T_HELP_33           "kpn <name>            - name des ausgewählten profils einstellen"
+#define T_HELP_34           "kpl                   - zeitprofile auflisten"
+#define T_HELP_35           "prof                  - profiler ergebnisse anzeigen und löschen"
+#define T_HELP_36           "slm <hex maske>       - serielle debug log kategorien einstellen"
+#define T_HELP_37           "mem                   - freien RAM und maximale stack und heap nutzung anzeigen"
+#define T_HELP_38           "eb                    - stapel von einstellungsänderungen beginnen"
+#define T_HELP_39           "ec                    - stapel von einstellungsänderungen ins EEPROM schreiben"
 
-#define T_HELP_40           "Tastatur: kbt,k101,kabd,kand,kasd,kxbd,kxnd,kxsd"
-#define T_HELP_41           "Seriell : sbr,scd,sld,sfc,sen"
-#define T_HELP_42           "Debug   : reset,ccrc,scrc,ep,er,ew"
+#define T_HELP_40           "Tastatur: "
+#define T_HELP_41           "Seriell : "
+#define T_HELP_42           "Debug   : "
 #define T_HELP_43           "Geben sie 'hilfe' ein für ausführlichere hilfe"
+#define T_HELP_44           "Maus    : "
+#define T_HELP_45           "kxr <ein|aus>         - XT host reset setzt auch die tastatur zurück"
+#define T_HELP_46           "kid <ein|aus>         - tastatur erkennen und ihre modell zeitwerte verwenden"
+#define T_HELP_47           "kml                   - tastatur modell zeitwerte auflisten"
+#define T_HELP_48           "kms                   - AT zeitwerte des profils für die letzte erkannte tastatur speichern"
+#define T_HELP_49           "kmc                   - tastatur modell zeitwerte löschen"
+#define T_HELP_50           "kin <ein|aus>         - text vom seriellen port in den XT host tippen"
+#define T_HELP_51           "kik <mSec>            - verzögerung zwischen vom seriellen port getippten tasten"
 
 #define T_MSG_01            "Berechnete CRC = "
 #define T_MSG_02            "Gespeicherte CRC = "
-#define T_MSG_03            "Befehl '" + command + "' nicht gefunden"
+#define T_MSG_03            "Befehl '"
 #define T_MSG_04            "Geben sie 'hilfe' ein für eine liste der befehle"
-#define T_MSG_05            "Ungültiger platinen typ"
+//#define T_MSG_05            ""
 #define T_MSG_06            "Platinen typ = "
 //#define T_MSG_07            ""
 #define T_MSG_08            "101 tasten sind aktiviert"
@@ -71,9 +95,9 @@
 #define T_MSG_15            "XT starten bit verzögerung = "
 #define T_MSG_16            "Host baudrate ist nicht gültig"
 #define T_MSG_17            "Baudrate = "
-#define T_MSG_18            "Zeichenverzögerung zu klein"
+//#define T_MSG_18            ""
 #define T_MSG_19            "Zeichenverzögerung = "
-#define T_MSG_20            "Zeilenverzögerung zu klein"
+//#define T_MSG_20            ""
 #define T_MSG_21            "Zeilenverzögerung = "
 #define T_MSG_22            "Xon/Xoff flusskontrolle ist aktiviert"
 #define T_MSG_23            "Xon/Xoff flusskontrolle ist deaktiviert"
@@ -83,5 +107,44 @@
 #define T_MSG_27            "EEPROM adresse nicht angegeben"
 #define T_MSG_28            "Schreibe an EEPROM adresse "
 #define T_MSG_29            "EEPROM wert nicht angegeben"
+#define T_MSG_30            "' nicht gefunden"
+#define T_MSG_31            "AT rahmenaufzeichnung ist aktiviert"
+#define T_MSG_32            "AT rahmenaufzeichnung ist deaktiviert"
+#define T_MSG_33            "Aufgezeichnete rahmen = "
+#define T_MSG_34            "Schlafzeit = "
+#define T_MSG_35            "AT paritätsfehler = "
+#define T_MSG_36            "AT stoppbitfehler = "
+#define T_MSG_37            "AT rahmen zeitüberschreitungen = "
+#define T_MSG_38            "AT verspätete abtastungen = "
+#define T_MSG_39            "AT taktperiode = "
+#define T_MSG_40            "PS/2 zu serieller maus ist aktiviert"
+#define T_MSG_41            "PS/2 zu serieller maus ist deaktiviert"
+#define T_MSG_42            "Startzeit = "
+#define T_MSG_43            "Reset bis erste taste = "
+#define T_MSG_44            "LED zyklus beim start ist aktiviert"
+#define T_MSG_45            "LED zyklus beim start ist deaktiviert"
+#define T_MSG_46            "Profil = "
+#define T_MSG_47            "Ungültiges profil"
+#define T_MSG_48            "Profiler nicht eingebaut, siehe PROFILE und PROFILE_SAMPLER in globals.h"
+#define T_MSG_49            "Log maske = "
+#define T_MSG_50            "Befehlswarteschlange voll, zeile verworfen"
+#define T_MSG_51            "Watchdog resets = "
+#define T_MSG_52            "Letzter hänger = "
+#define T_MSG_53            "Watchdog reset, letzter hänger = "
+#define T_MSG_54            "XT host reset setzt auch die tastatur zurück"
+#define T_MSG_55            "XT host reset setzt die tastatur nicht zurück"
+#define T_MSG_56            "XT host resets = "
+#define T_MSG_57            "Gültiger bereich ist "
+#define T_MSG_58            "Tastatur ID = "
+#define T_MSG_59            "Tastatur modell = "
+#define T_MSG_60            "keins"
+#define T_MSG_61            "Tastaturerkennung ist aktiviert"
+#define T_MSG_62            "Tastaturerkennung ist deaktiviert"
+#define T_MSG_63            "Im letzten lauf wurde keine tastatur erkannt"
+#define T_MSG_64            "Tastatur modell zeitwerte sind voll, mit kmc löschen"
+#define T_MSG_65            "Serielle tasteneingabe ist aktiviert"
+#define T_MSG_66            "Serielle tasteneingabe ist deaktiviert"
+#define T_MSG_67            "Verzögerung eingegebener tasten = "
+#define T_MSG_68            "Nicht genug speicher für einen stapel"
 
 #endif // _GERMAN_H_
@@ -25,12 +25,60 @@
 //#include "german.h"
 //*************************************************************************
 
+/*************************************************************************
+ * Uncomment to receive AT frames with Timer1 input capture instead of the
+ * INT1 external interrupt. AT_CLK must also be wired to AT_CLK_ICP (D8),
+ * which is the AT_CLK LED on the DEV board, so the DEV board LED's can
+ * not be used with this option.
+ *************************************************************************/
+//#define AT_RX_INPUT_CAPTURE
+//*************************************************************************
+
+/*************************************************************************
+ * Uncomment to build the hot path span profiler, see the prof command.
+ * Timer1 is taken over to time the spans, so leave it commented out for
+ * release builds.
+ *************************************************************************/
+//#define PROFILE
+//*************************************************************************
+
+/*************************************************************************
+ * Uncomment to build the main loop sampling profiler, see the prof
+ * command. It takes over Timer2 and wakes the CPU about 100 times a
+ * second, which is cheap enough to leave in a field build.
+ *************************************************************************/
+//#define PROFILE_SAMPLER
+//*************************************************************************
+
+/*************************************************************************
+ * Serial debug log categories and levels. Categories left out of
+ * LOG_BUILD_MASK and levels above LOG_BUILD_LEVEL compile to nothing,
+ * including their strings. For a release build set LOG_BUILD_MASK to 0,
+ * or to LOG_ALL with LOG_BUILD_LEVEL set to LOG_ERROR to keep the errors.
+ * The categories that are built in are turned on and off at run time
+ * with the slm command.
+ *************************************************************************/
+#define LOG_AT_RX               0x01    // Bytes received from the keyboard and their translation
+#define LOG_XT_TX               0x02    // Bytes sent to the XT host
+#define LOG_AT_TX               0x04    // Bytes sent to the keyboard
+#define LOG_LEDS                0x08    // Keyboard LED updates
+#define LOG_SPECIAL             0x10    // BAT, ACK and other non key bytes
+#define LOG_ALL                 0x1F
+
+#define LOG_ERROR               1
+#define LOG_INFO                2
+#define LOG_TRACE               3
+
+#define LOG_BUILD_MASK          LOG_ALL
+#define LOG_BUILD_LEVEL         LOG_TRACE
+//*************************************************************************
+
 /*************************************************************************
  * Global Constants
  *************************************************************************/
 
 // Software info
-const String  VERSION           = "01.00.00";
+#define VERSION                 "01.00.00"
 
 // Host board type
 #define B_STD                   1       // Standard board with no LED's or dev options switches
@@ -47,6 +95,48 @@ const String  VERSION           = "01.00.00";
 
 // Serial constants
 #define TX_DELAY                20    // Time delay between serial data in uS
+#define S_LINE_SIZE             48      // Max command line length including the terminator
+#define S_QUEUE_SIZE            96      // Bytes of received command lines waiting to be run, two full lines
+#define S_SINK_SIZE             16      // Bytes of the ring quiet output is written to
+
+// AT receiver constants
+#define AT_BIT_TIMEOUT          500     // Max uSecs between AT clock edges within a frame
+#define AT_LATE_TICKS           40      // Max Timer1 ticks (0.5 uSec) from a clock edge to sampling AT_DATA
+#ifdef AT_RX_INPUT_CAPTURE
+#define AT_EDGE_TICKS           2       // AT clock edge times per uSec, the Timer1 capture count at 2MHz
+#else
+#define AT_EDGE_TICKS           1       // AT clock edge times per uSec, taken from micros()
+#endif
+#define AT_PARITY_ERROR         0x01    // Frame status bit for a bad parity bit
+#define AT_STOP_ERROR           0x02    // Frame status bit for a bad stop bit
+#define AT_TIMEOUT_ERROR        0x04    // Frame status bit for a frame abandoned part way
+#define AT_LATE_ERROR           0x08    // AT_DATA sampled too long after the clock edge
+
+// Bus wait and watchdog constants
+#define AT_BUSY_TIMEOUT         2000    // Max uSecs to wait for an AT frame being received to finish
+#define AT_RTS_TIMEOUT          15000   // Max uSecs for the keyboard to start clocking a byte sent to it
+#define S_XOFF_TIMEOUT          10000   // Max mSecs to hold output waiting for XON
+#define WD_TIMEOUT              WDTO_1S // Watchdog timeout in run mode, one of the avr/wdt.h WDTO_xxx values
+
+// Keyboard LED update constants
+#define K_LED_COALESCE          10      // mSecs to wait for further lock key changes before updating the LED's
+#define K_LED_ACK_TIMEOUT       20      // Max mSecs to wait for the keyboard to ACK an LED update byte
+#define K_LED_SHOW_STEP         250     // mSecs each keyboard LED is lit for in the boot LED cycle
+#define K_DEV_FLASH_TIME        500     // mSecs the DEV board LED's are lit for at boot
+
+// Keyboard identification constants
+#define K_ID_TIMEOUT            25      // Max mSecs to wait for the ACK and each ID byte after sending 0xF2
+
+// XT host constants
+#define XT_RESET_TIME           10000   // Min uSecs the XT host holds XT_CLK low to reset the keyboard
+#define XT_BUSY_TIMEOUT         5       // Max mSecs an injected key waits for the XT host to release XT_DATA
+#define XT_QUEUE_SIZE           8       // XT codes waiting to be sent to the XT host
+
+// PS/2 mouse constants
+#define M_BAUD                  1200    // Microsoft serial mouse baud rate
+#define M_CLK_TIMEOUT           15000   // Max uSecs to wait for the mouse to clock a bit
+#define M_INHIBIT_DELAY         120     // uSecs to hold MS_CLK low before sending to the mouse
+#define M_REPLY_TIMEOUT         1000    // Max mSecs to wait for a reply from the mouse
 
 // Default serial definitions
 #define S_HOST                  Serial
@@ -55,10 +145,21 @@ const String  VERSION           = "01.00.00";
 #define S_DEF_LINE_DELAY        0       // Default host inter line delay in mSec
 #define S_DEF_XON_XOFF          0       // Default value of 1 means enabled
 #define S_DEF_SERIAL_ENABLED    0       // Default value of 1 means enabled
+#define S_DEF_LOG_MASK          LOG_ALL // Default log categories turned on
 
 // Default keyboard definitions
 #define K_DEF_EXT_KEYS_ENABLED  0       // Default value of 1 means enabled
 #define K_DEF_BOARD_TYPE        1       // Default value of 1 for the standard board
+#define K_DEF_CAPTURE_ENABLED   0       // Default value of 1 means enabled
+#define K_DEF_LED_SHOW          1       // Default value of 1 means cycle the keyboard LED's at boot
+#define K_DEF_XT_RESET_KB       1       // Default value of 1 means an XT host reset also resets the keyboard
+#define K_DEF_PROFILE           0       // Default timing profile used when not selected by DIP switches
+#define K_DEF_KB_ID             1       // Default value of 1 means identify the keyboard and use its model timings
+#define K_DEF_INJECT            0       // Default value of 1 means type text received on the serial port
+#define K_DEF_INJECT_DELAY      0       // Default mSecs between injected keys
+
+// Default mouse definitions
+#define M_DEF_MOUSE_ENABLED     0       // Default value of 1 means enabled
 
 #define K_DEF_AT_BIT_DELAY      30      // AT_CLK bit time delay (per clock state)
 #define K_DEF_AT_NEXT_DELAY     3       // Wait period after sending byte to the AT keyboard
@@ -68,6 +169,18 @@ const String  VERSION           = "01.00.00";
 #define K_DEF_XT_NEXT_DELAY     100     // Wait period after sending byte to the XT keyboard
 #define K_DEF_XT_START_DELAY    5       // Settling period after changing XT_CLK before changing XT_DATA
 
+// Keyboard timing profile definitions
+#define K_PROFILES              4       // Number of timing profiles held in the EEPROM
+#define K_PROFILE_NAME          8       // Max length of a profile name, not null terminated when full
+#define K_PROFILE_SIZE          15      // Bytes per profile, name + 6 timings + flags
+#define K_PF_EXT_101            0x01    // Profile flag for enhanced 101 keys
+
+// Keyboard model timing cache definitions
+#define K_MODELS                4       // Number of keyboard models held in the EEPROM
+#define K_MODEL_SIZE            6       // Bytes per model, ID + clock period + 3 AT timings
+#define K_MODEL_CLOCK           8       // Max uSecs the clock period can differ from a model's
+#define K_NO_MODEL              0xFFFF  // ID of an unused model entry, or no keyboard identified
+
 // EEPROM address definitions
 #define E_CHECKSUM              0       // 4 bytes CRC32 checksum of E_SIZE bytes
 #define E_SIGNATURE             4       // 2 bytes containing the value 55 AA
@@ -78,14 +191,20 @@ const String  VERSION           = "01.00.00";
 #define E_LINE_DELAY            16      // 2 bytes (int) for host serial inter-line delay
 #define E_XON_XOFF              18      // 1 byte (byte) for XON/XOFF enabled flag
 #define E_SERIAL_ENABLED        19      // 1 byte (byte) for serial enabled flag
-#define E_EXT_KEYS_ENABLED      20      // 1 byte (byte) for 101 extended keys flag
+                                // 20 unused, 101 extended keys flag moved to the profiles
 #define E_BOARD_TYPE            21      // 2 bytes (int) for the board type
-#define E_AT_BIT_DELAY          23      // 1 byte (byte) for AT bit delay
-#define E_AT_NEXT_DELAY         24      // 1 byte (byte) for AT next byte delay
-#define E_AT_START_DELAY        25      // 1 byte (byte) for AT start bit delay
-#define E_XT_BIT_DELAY          26      // 1 byte (byte) for XT bit delay
-#define E_XT_NEXT_DELAY         27      // 1 byte (byte) for XT next byte delay
-#define E_XT_START_DELAY        28      // 1 byte (byte) for XT start bit delay
-#define E_END_ADDRESS           29      // End of EEPROM values
+                                // 23 - 28 unused, delay timings moved to the profiles
+#define E_CAPTURE_ENABLED       29      // 1 byte (byte) for AT frame capture enabled flag
+#define E_MOUSE_ENABLED         30      // 1 byte (byte) for PS/2 to serial mouse enabled flag
+#define E_LED_SHOW              31      // 1 byte (byte) for the boot keyboard LED cycle enabled flag
+#define E_PROFILE               32      // 1 byte (byte) for the selected timing profile
+#define E_PROFILES              33      // K_PROFILES * K_PROFILE_SIZE bytes for the timing profiles
+#define E_LOG_MASK              93      // 1 byte (byte) for the serial debug log category mask
+#define E_XT_RESET_KB           94      // 1 byte (byte) for the XT host reset also resets the keyboard flag
+#define E_KB_ID                 95      // 1 byte (byte) for the identify keyboard at boot flag
+#define E_MODELS                96      // K_MODELS * K_MODEL_SIZE bytes for the keyboard model timings
+#define E_INJECT                120     // 1 byte (byte) for the serial keystroke injection enabled flag
+#define E_INJECT_DELAY          121     // 1 byte (byte) for the mSecs between injected keys
+#define E_END_ADDRESS           122     // End of EEPROM values
 
 #endif // _GLOBALS_H_
@@ -0,0 +1,255 @@
+/*
+ * inject.cpp
+ * 
+ * Serial keystroke injection into the XT host.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+*/
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "eeprom_utils.h"
+#include "inject.h"
+#include "keyboard.h"
+
+#define INJ_LEFT_SHIFT          0x2A    // XT make code of Left Shift
+#define INJ_BREAK               0x80    // Set in an XT break code
+#define INJ_ROOM                12      // Most XT codes queued for one character, a broken \x escape types 3 more
+
+// Escape states
+#define INJ_TEXT                0       // Typing text
+#define INJ_ESCAPE              1       // '\' received
+#define INJ_RAW                 2       // '\x' received
+#define INJ_HEX                 3       // '\x' and the first hex digit received
+
+static byte inj_queue[INJ_QUEUE_SIZE];
+static byte inj_head      = 0;
+static byte inj_tail      = 0;
+static byte inj_count     = 0;
+
+static byte inj_state     = INJ_TEXT;
+static byte inj_raw       = 0;
+static char inj_digit     = 0;          // First hex digit of a raw code, typed if the escape is broken
+static bool inj_shift     = false;      // Left Shift is held down by injected keys
+static bool inj_xoff      = false;      // XOFF sent to the PC
+static char inj_prev      = 0;
+
+static byte inj_delay     = 0;
+static unsigned long inj_time = 0;
+
+//*************************************************************************
+static void injQueue(const byte xt_code)
+{
+  inj_queue[inj_head] = xt_code;
+  inj_head = (inj_head + 1) % INJ_QUEUE_SIZE;
+  inj_count++;
+}
+
+//*************************************************************************
+// Returns the value of hex digit 'c', or 0xFF if it is not one
+static byte injHex(const char c)
+{
+  if (c >= '0' && c <= '9')
+  {
+    return c - '0';
+  }
+  if (c >= 'A' && c <= 'F')
+  {
+    return c - 'A' + 10;
+  }
+  if (c >= 'a' && c <= 'f')
+  {
+    return c - 'a' + 10;
+  }
+  return 0xFF;
+}
+
+//*************************************************************************
+static void injType(const char c)
+{
+  byte xt_code = ASCII2XT(c);
+  bool shift = (xt_code & K_SHIFT) != 0;
+
+  // A CR LF pair types a single Enter
+  if ((c == '\n' && inj_prev == '\r') || xt_code == 0)
+  {
+    return;
+  }
+  xt_code &= ~K_SHIFT;
+
+  // Left Shift is held over runs of shifted characters
+  if (shift != inj_shift)
+  {
+    injQueue(shift ? INJ_LEFT_SHIFT : INJ_LEFT_SHIFT | INJ_BREAK);
+    inj_shift = shift;
+  }
+  injQueue(xt_code);
+  injQueue(xt_code | INJ_BREAK);
+}
+
+//*************************************************************************
+// Only '\x' and 2 hex digits is a raw code and '\\' a single '\'. Any other
+// '\' is typed as it is, so DOS paths such as C:\DOS can be typed, and an
+// escape that turns out not to be a raw code is typed as it was received.
+static void injChar(const char c)
+{
+  byte digit = injHex(c);
+  bool text = true;             // 'c' is typed rather than taken by an escape
+
+  switch(inj_state)
+  {
+    case INJ_ESCAPE:
+      inj_state = INJ_TEXT;
+      if (c == 'x')
+      {
+        inj_state = INJ_RAW;
+        text = false;
+      }
+      else
+      {
+        injType('\\');
+        text = (c != '\\');
+      }
+      break;
+
+    case INJ_RAW:
+      inj_state = INJ_TEXT;
+      if (digit != 0xFF)
+      {
+        inj_raw = digit << 4;
+        inj_digit = c;
+        inj_state = INJ_HEX;
+        text = false;
+      }
+      else
+      {
+        injType('\\');
+        injType('x');
+      }
+      break;
+
+    case INJ_HEX:
+      inj_state = INJ_TEXT;
+      if (digit != 0xFF)
+      {
+        injQueue(inj_raw | digit);
+        text = false;
+      }
+      else
+      {
+        injType('\\');
+        injType('x');
+        injType(inj_digit);
+      }
+      break;
+
+    default:
+      break;
+  }
+
+  if (text)
+  {
+    if (c == '\\')
+    {
+      inj_state = INJ_ESCAPE;
+    }
+    else
+    {
+      injType(c);
+    }
+  }
+  inj_prev = c;
+}
+
+//*************************************************************************
+bool injInit()
+{
+  byte enabled = 0;
+
+  eGet(E_INJECT, enabled);
+  eGet(E_INJECT_DELAY, inj_delay);
+  injClear();
+  return enabled != 0;
+}
+
+//*************************************************************************
+void injClear()
+{
+  inj_head = inj_tail = inj_count = 0;
+  inj_state = INJ_TEXT;
+  inj_shift = false;
+  inj_prev = 0;
+}
+
+//*************************************************************************
+void injPoll()
+{
+  int waiting;
+
+  while (S_HOST.available() > 0 && (INJ_QUEUE_SIZE - inj_count) >= INJ_ROOM)
+  {
+    injChar(S_HOST.read());
+  }
+
+  waiting = S_HOST.available();
+
+  // Let go of Left Shift once there is nothing more to type
+  if (inj_shift && inj_count == 0 && waiting == 0)
+  {
+    injQueue(INJ_LEFT_SHIFT | INJ_BREAK);
+    inj_shift = false;
+  }
+
+  // Hold the PC off before the UART receive buffer overflows
+  if (!inj_xoff && waiting >= INJ_XOFF_LEVEL)
+  {
+    S_HOST.write(XOFF);
+    inj_xoff = true;
+  }
+  else if (inj_xoff && waiting <= INJ_XON_LEVEL)
+  {
+    S_HOST.write(XON);
+    inj_xoff = false;
+  }
+}
+
+//*************************************************************************
+bool injPending()
+{
+  return inj_count > 0;
+}
+
+//*************************************************************************
+bool injNext(byte &xt_code)
+{
+  if (inj_count == 0)
+  {
+    return false;
+  }
+
+  // The delay runs from the break code of the last key
+  if (inj_delay > 0 && (millis() - inj_time) < inj_delay)
+  {
+    return false;
+  }
+
+  xt_code = inj_queue[inj_tail];
+  inj_tail = (inj_tail + 1) % INJ_QUEUE_SIZE;
+  inj_count--;
+
+  if (xt_code & INJ_BREAK)
+  {
+    inj_time = millis();
+  }
+  return true;
+}
@@ -0,0 +1,71 @@
+#ifndef _INJECT_H_
+#define _INJECT_H_
+
+/*
+ * inject.h
+ * 
+ * Serial keystroke injection, for typing text into the XT host from a PC.
+ * 
+ * In run mode, text received on the host serial port is turned into XT
+ * make and break codes and queued to be sent to the XT host between the
+ * keyboard's own key presses. Upper case and shifted characters are typed
+ * with Left Shift. '\x' followed by 2 hex digits queues that raw XT code,
+ * e.g. \x1D for Left Ctrl down and \x9D for up, and '\\' types a '\'. Any
+ * other '\' is typed as it is. The PC is held off with XOFF while the
+ * queue is full.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#define INJ_QUEUE_SIZE          64      // XT codes waiting to be sent to the XT host
+#define INJ_XOFF_LEVEL          16      // Send XOFF when this many received characters are waiting
+#define INJ_XON_LEVEL           4       // Send XON again when no more than this many are waiting
+
+/*************************************************************************
+ * injInit
+ * 
+ * Loads the delay between injected keys from EEPROM and empties the
+ * queue. Returns true if keystroke injection is enabled.
+ *************************************************************************/
+bool injInit();
+
+/*************************************************************************
+ * injClear
+ * 
+ * Empties the queue, e.g. when the XT host resets the keyboard.
+ *************************************************************************/
+void injClear();
+
+/*************************************************************************
+ * injPoll
+ * 
+ * Turns the characters received on the host serial port into XT codes
+ * while there is room in the queue, and sends XOFF and XON to the PC as
+ * the received characters back up and drain. Call often.
+ *************************************************************************/
+void injPoll();
+
+/*************************************************************************
+ * injPending
+ * 
+ * Returns true if there are XT codes waiting to be sent.
+ *************************************************************************/
+bool injPending();
+
+/*************************************************************************
+ * injNext
+ * 
+ * Takes the next XT code to send into 'xt_code'. Returns false if there
+ * is none, or if the delay after the last injected key has not run out.
+ *************************************************************************/
+bool injNext(byte &xt_code);
+
+#endif // _INJECT_H_
@@ -0,0 +1,109 @@
+#ifndef _KEY_TABLES_H_
+#define _KEY_TABLES_H_
+
+/*
+ * key_tables.h
+ * 
+ * Scan code translation tables.
+ * 
+ * GENERATED by tools/gen_key_tables.py from tools/keys.csv (105 keys).
+ * Do not edit, change the spec and regenerate instead.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ */
+
+#define KT_STD_SIZE             0x84
+#define KT_EXT_SIZE             0x80
+#define KT_BITS_SIZE            16
+#define KT_ASCII_SIZE           0x80
+#define KT_SHIFT                0x80
+
+// Tests bit 'code' of a PROGMEM bitset
+#define KT_BIT(bits, code)      (pgm_read_byte(&(bits)[(code) >> 3]) & (1 << ((code) & 7)))
+
+// ASCII to set 1 make code for typing text, KT_SHIFT set if shifted
+static const byte kt_ascii[KT_ASCII_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x0F, 0x1C, 0x00, 0x00, 0x1C, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x00,
+  0x39, 0x82, 0xA8, 0x84, 0x85, 0x86, 0x88, 0x28, 0x8A, 0x8B, 0x89, 0x8D, 0x33, 0x0C, 0x34, 0x35,
+  0x0B, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0A, 0xA7, 0x27, 0xB3, 0x0D, 0xB4, 0xB5,
+  0x83, 0x9E, 0xB0, 0xAE, 0xA0, 0x92, 0xA1, 0xA2, 0xA3, 0x97, 0xA4, 0xA5, 0xA6, 0xB2, 0xB1, 0x98,
+  0x99, 0x90, 0x93, 0x9F, 0x94, 0x96, 0xAF, 0x91, 0xAD, 0x95, 0xAC, 0x1A, 0x2B, 0x1B, 0x87, 0x8C,
+  0x29, 0x1E, 0x30, 0x2E, 0x20, 0x12, 0x21, 0x22, 0x23, 0x17, 0x24, 0x25, 0x26, 0x32, 0x31, 0x18,
+  0x19, 0x10, 0x13, 0x1F, 0x14, 0x16, 0x2F, 0x11, 0x2D, 0x15, 0x2C, 0x9A, 0xAB, 0x9B, 0xA9, 0x00
+};
+
+// Set 2 to set 1 for codes sent without a prefix
+static const byte kt_std[KT_STD_SIZE] PROGMEM =
+{
+  0x00, 0x43, 0x00, 0x3F, 0x3D, 0x3B, 0x3C, 0x58, 0x00, 0x44, 0x42, 0x40, 0x3E, 0x0F, 0x29, 0x00,
+  0x00, 0x38, 0x2A, 0x00, 0x1D, 0x10, 0x02, 0x00, 0x00, 0x00, 0x2C, 0x1F, 0x1E, 0x11, 0x03, 0x00,
+  0x00, 0x2E, 0x2D, 0x20, 0x12, 0x05, 0x04, 0x00, 0x00, 0x39, 0x2F, 0x21, 0x14, 0x13, 0x06, 0x00,
+  0x00, 0x31, 0x30, 0x23, 0x22, 0x15, 0x07, 0x00, 0x00, 0x00, 0x32, 0x24, 0x16, 0x08, 0x09, 0x00,
+  0x00, 0x33, 0x25, 0x17, 0x18, 0x0B, 0x0A, 0x00, 0x00, 0x34, 0x35, 0x26, 0x27, 0x19, 0x0C, 0x00,
+  0x00, 0x00, 0x28, 0x00, 0x1A, 0x0D, 0x00, 0x00, 0x3A, 0x36, 0x1C, 0x1B, 0x00, 0x2B, 0x00, 0x00,
+  0x00, 0x56, 0x00, 0x00, 0x00, 0x00, 0x0E, 0x00, 0x00, 0x4F, 0x00, 0x4B, 0x47, 0x00, 0x00, 0x00,
+  0x52, 0x53, 0x50, 0x4C, 0x4D, 0x48, 0x01, 0x45, 0x57, 0x4E, 0x51, 0x4A, 0x37, 0x49, 0x46, 0x00,
+  0x00, 0x00, 0x00, 0x41
+};
+
+// Set 2 to set 1 for E0 prefixed codes
+static const byte kt_ext[KT_EXT_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x38, 0x00, 0x00, 0x1D, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5B,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5C, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5D,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x35, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1C, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x4F, 0x00, 0x4B, 0x47, 0x00, 0x00, 0x00,
+  0x52, 0x53, 0x50, 0x00, 0x4D, 0x48, 0x00, 0x00, 0x00, 0x00, 0x51, 0x00, 0x37, 0x49, 0x00, 0x00
+};
+
+// Set 1 to set 2 for codes sent without a prefix
+static const byte kt_std_rev[KT_EXT_SIZE] PROGMEM =
+{
+  0x00, 0x76, 0x16, 0x1E, 0x26, 0x25, 0x2E, 0x36, 0x3D, 0x3E, 0x46, 0x45, 0x4E, 0x55, 0x66, 0x0D,
+  0x15, 0x1D, 0x24, 0x2D, 0x2C, 0x35, 0x3C, 0x43, 0x44, 0x4D, 0x54, 0x5B, 0x5A, 0x14, 0x1C, 0x1B,
+  0x23, 0x2B, 0x34, 0x33, 0x3B, 0x42, 0x4B, 0x4C, 0x52, 0x0E, 0x12, 0x5D, 0x1A, 0x22, 0x21, 0x2A,
+  0x32, 0x31, 0x3A, 0x41, 0x49, 0x4A, 0x59, 0x7C, 0x11, 0x29, 0x58, 0x05, 0x06, 0x04, 0x0C, 0x03,
+  0x0B, 0x83, 0x0A, 0x01, 0x09, 0x77, 0x7E, 0x6C, 0x75, 0x7D, 0x7B, 0x6B, 0x73, 0x74, 0x79, 0x69,
+  0x72, 0x7A, 0x70, 0x71, 0x00, 0x00, 0x61, 0x78, 0x07, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// Set 1 to set 2 for E0 prefixed codes
+static const byte kt_ext_rev[KT_EXT_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x5A, 0x14, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x4A, 0x00, 0x7C, 0x11, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x6C, 0x75, 0x7D, 0x00, 0x6B, 0x00, 0x74, 0x00, 0x69,
+  0x72, 0x7A, 0x70, 0x71, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1F, 0x27, 0x2F, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// E0 prefixed codes where the E0 is always passed on
+static const byte kt_ext_bits[KT_BITS_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x12, 0x80, 0x80, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// E0 prefixed 101 key codes, the E0 is passed on when k101 is on
+static const byte kt_nav_bits[KT_BITS_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x1A, 0x37, 0x34
+};
+
+// E0 prefixed codes where the E0 is dropped
+static const byte kt_strip_bits[KT_BITS_SIZE] PROGMEM =
+{
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x04, 0x00, 0x04, 0x00, 0x00, 0x00, 0x00
+};
+
+#endif // _KEY_TABLES_H_
@@ -20,322 +20,260 @@
 #include "globals.h"
 
 #include "eeprom_utils.h"
+#include "key_tables.h"
+#include "keyboard.h"
 
-static bool ext_keys_enabled     = false;
-static unsigned int board_type   = 1;
-
-static unsigned int i;
-
-struct key_code
-{
-  byte key;
-  byte xt_code;
-  byte at_code;
-};
+static_assert(sizeof(struct kb_profile) == K_PROFILE_SIZE, "K_PROFILE_SIZE does not match kb_profile");
+static_assert(E_PROFILES + (K_PROFILES * K_PROFILE_SIZE) <= E_END_ADDRESS, "Profiles overrun E_END_ADDRESS");
+static_assert(K_SHIFT == KT_SHIFT, "K_SHIFT does not match KT_SHIFT");
+static_assert(sizeof(struct kb_model) == K_MODEL_SIZE, "K_MODEL_SIZE does not match kb_model");
+static_assert(E_MODELS + (K_MODELS * K_MODEL_SIZE) <= E_END_ADDRESS, "Models overrun E_END_ADDRESS");
 
-// Standard non-extended key codes
-static const struct key_code key_table[] =
-{
-  {1, 0x29, 0x0E},
-  {2, 0x02, 0x16},
-  {3, 0x03, 0x1E},
-  {4, 0x04, 0x26},
-  {5, 0x05, 0x25},
-  {6, 0x06, 0x2E},
-  {7, 0x07, 0x36},
-  {8, 0x08, 0x3D},
-  {9, 0x09, 0x3E},
-  {10, 0x0A, 0x46},
-  {11, 0x0B, 0x45},
-  {12, 0x0C, 0x4E},
-  {13, 0x0D, 0x55},
-  {15, 0x0E, 0x66},
-  {16, 0x0F, 0x0D},
-  {17, 0x10, 0x15},
-  {18, 0x11, 0x1D},
-  {19, 0x12, 0x24},
-  {20, 0x13, 0x2D},
-  {21, 0x14, 0x2C},
-  {22, 0x15, 0x35},
-  {23, 0x16, 0x3C},
-  {24, 0x17, 0x43},
-  {25, 0x18, 0x44},
-  {26, 0x19, 0x4D},
-  {27, 0x1A, 0x54},
-  {28, 0x1B, 0x5B},
-  {29, 0x2B, 0x5D},
-  {30, 0x3A, 0x58},
-  {31, 0x1E, 0x1C},
-  {32, 0x1F, 0x1B},
-  {33, 0x20, 0x23},
-  {34, 0x21, 0x2B},
-  {35, 0x22, 0x34},
-  {36, 0x23, 0x33},
-  {37, 0x24, 0x3B},
-  {38, 0x25, 0x42},
-  {39, 0x26, 0x4B},
-  {40, 0x27, 0x4C},
-  {41, 0x28, 0x52},
-  {42, 0x2B, 0x5D},
-  {43, 0x1C, 0x5A},
-  {44, 0x2A, 0x12},
-  {45, 0x56, 0x61},
-  {46, 0x2C, 0x1A},
-  {47, 0x2D, 0x22},
-  {48, 0x2E, 0x21},
-  {49, 0x2F, 0x2A},
-  {50, 0x30, 0x32},
-  {51, 0x31, 0x31},
-  {52, 0x32, 0x3A},
-  {53, 0x33, 0x41},
-  {54, 0x34, 0x49},
-  {55, 0x35, 0x4A},
-  {57, 0x36, 0x59},
-  {58, 0x1D, 0x14},
-  {60, 0x38, 0x11},
-  {61, 0x39, 0x29},
-  {90, 0x45, 0x77},
-  {91, 0x47, 0x6C},
-  {92, 0x4B, 0x6B},
-  {93, 0x4F, 0x69},
-  {96, 0x48, 0x75},
-  {97, 0x4C, 0x73},
-  {98, 0x50, 0x72},
-  {99, 0x52, 0x70},
-  {100, 0x37, 0x7C},
-  {101, 0x49, 0x7D},
-  {102, 0x4D, 0x74},
-  {103, 0x51, 0x7A},
-  {104, 0x53, 0x71},
-  {105, 0x4A, 0x7B},
-  {106, 0x4E, 0x79},
-  {110, 0x01, 0x76},
-  {112, 0x3B, 0x05},
-  {113, 0x3C, 0x06},
-  {114, 0x3D, 0x04},
-  {115, 0x3E, 0x0C},
-  {116, 0x3F, 0x03},
-  {117, 0x40, 0x0B},
-  {118, 0x41, 0x83},
-  {119, 0x42, 0x0A},
-  {120, 0x43, 0x01},
-  {121, 0x44, 0x09},
-  {122, 0x57, 0x78},
-  {123, 0x58, 0x07},
-  {125, 0x46, 0x7E},
-  {0, 0x00, 0x00}
-};
-
-// Extended (pre-fixed with '0xEO) single byte key codes (Not 101+ extra navigation keys)
-static const struct key_code key_table_ext[] =
-{
-  {59, 0x5B, 0x1F},   // Win
-  {62, 0x38, 0x11},   // Right Alt
-  {63, 0x5C, 0x27},   // Context Menu
-  {64, 0x1D, 0x14},   // Right Shift
-  {65, 0x5D, 0x2F},   // Alt Graphics
-  {0, 0x00, 0x00}
-};
-
-// Extended (pre-fixed with '0xEO) single byte key codes 101+ extra navigation keys
-static const struct key_code key_table_ext_nav[] =
-{
-  {0, 0xF0, 0xF0},    // key up
-  {75, 0x52, 0x70},   // Insert
-  {76, 0x53, 0x71},   // Delete
-  {79, 0x4B, 0x6B},   // Left Arrow
-  {80, 0x47, 0x6C},   // Home
-  {81, 0x4F, 0x69},   // End
-  {83, 0x48, 0x75},   // Up Arrow
-  {84, 0x50, 0x72},   // Down Arrow
-  {85, 0x49, 0x7D},   // Page Up
-  {86, 0x51, 0x7A},   // Page Down
-  {89, 0x4D, 0x74},   // Right Arrow
-  {95, 0x35, 0x4A},   // Numpad /
-  {100, 0x37, 0x7C},  // Numpad * and Print Screen
-  {108, 0x1C, 0x5A},  // Numpad Enter
-  {0, 0x00, 0x00}
-};
-
-// Extended (pre-fixed with '0xEO) single byte key codes to have the 0xE0 stripped
-static const struct key_code key_table_ext_strip[] =
-{
-  {95, 0x35, 0x4A},   // Numpad /
-  {108, 0x1C, 0x5A},  // Numpad Enter
-  {0, 0x00, 0x00}
-};
+static unsigned int board_type   = 1;
 
 //*************************************************************************
 byte AT2XT(byte scan_code)
 {
-  static byte xt_code;
-  xt_code = 0;
-
-  for(i = 0; i < sizeof(key_table); i++)
+  if (scan_code < KT_STD_SIZE)
   {
-    if (key_table[i].at_code == scan_code)
-    {
-      xt_code = key_table[i].xt_code;
-      break;
-    }
+    return pgm_read_byte(&kt_std[scan_code]);
   }
-  return xt_code;
+  return 0;
 }
 
 //*************************************************************************
 byte AT2XTExt(byte scan_code)
 {
-  static byte xt_code;
-  xt_code = 0;
-
-  for(i = 0; i < sizeof(key_table_ext); i++)
+  if (scan_code < KT_EXT_SIZE && KT_BIT(kt_ext_bits, scan_code))
   {
-    if (key_table_ext[i].at_code == scan_code)
-    {
-      xt_code = key_table_ext[i].xt_code;
-      break;
-    }
+    return pgm_read_byte(&kt_ext[scan_code]);
   }
-  return xt_code;
+  return 0;
 }
 
 //*************************************************************************
 byte AT2XTExtNav(byte scan_code)
 {
-  static byte xt_code;
-  xt_code = 0;
-
-  for(i = 0; i < sizeof(key_table_ext_nav); i++)
+  if (scan_code < KT_EXT_SIZE && KT_BIT(kt_nav_bits, scan_code))
   {
-    if (key_table_ext_nav[i].at_code == scan_code)
-    {
-      xt_code = key_table_ext_nav[i].xt_code;
-      break;
-    }
+    return pgm_read_byte(&kt_ext[scan_code]);
   }
-  return xt_code;
+  return 0;
 }
 
 //*************************************************************************
 byte AT2XTExtStrip(byte scan_code)
 {
-  for(i = 0; i < sizeof(key_table_ext_strip); i++)
+  if (scan_code < KT_EXT_SIZE && KT_BIT(kt_strip_bits, scan_code))
   {
-    if (key_table_ext_strip[i].at_code == scan_code)
-    {
-      return key_table_ext_strip[i].xt_code;
-    }
+    return pgm_read_byte(&kt_ext[scan_code]);
   }
   return 0;
 }
 
 //*************************************************************************
-void kBoardType(const unsigned int value)
+byte XT2AT(byte xt_code)
 {
-  EEPROM.get(E_BOARD_TYPE, board_type);
-  if (board_type != value)
+  if (xt_code < KT_EXT_SIZE)
   {
-    if ((value > 0) & (value < B_LAST))
-    {
-      board_type = value;
-      EEPROM.put(E_BOARD_TYPE, value);
-      eUpdateCrc();
-    }
+    return pgm_read_byte(&kt_std_rev[xt_code]);
+  }
+  return 0;
+}
+
+//*************************************************************************
+byte XT2ATExt(byte xt_code)
+{
+  if (xt_code < KT_EXT_SIZE)
+  {
+    return pgm_read_byte(&kt_ext_rev[xt_code]);
+  }
+  return 0;
+}
+
+//*************************************************************************
+byte ASCII2XT(char ascii)
+{
+  if ((byte) ascii < KT_ASCII_SIZE)
+  {
+    return pgm_read_byte(&kt_ascii[(byte) ascii]);
   }
+  return 0;
 }
 
 //*************************************************************************
 unsigned int kGetBoardType()
 {
-  EEPROM.get(E_BOARD_TYPE, board_type);
+  eGet(E_BOARD_TYPE, board_type);
   return board_type;
 }
 
 //*************************************************************************
-void kDelayTimings(byte value, byte item)
+int kProfileAddress(const byte profile)
+{
+  return E_PROFILES + (profile * K_PROFILE_SIZE);
+}
+
+//*************************************************************************
+bool kGetLedShow()
 {
-  switch(item)
+  byte value = 0;
+
+  eGet(E_LED_SHOW, value);
+  if (value == 0)
   {
-    case 1:
-      EEPROM.put(E_AT_BIT_DELAY, value);
-      break;
-    case 2:
-      EEPROM.put(E_AT_NEXT_DELAY, value);
-      break;
-    case 3:
-      EEPROM.put(E_AT_START_DELAY, value);
-      break;
-    case 4:
-      EEPROM.put(E_XT_BIT_DELAY, value);
-      break;
-    case 5:
-      EEPROM.put(E_XT_NEXT_DELAY, value);
-      break;
-    case 6:
-      EEPROM.put(E_XT_START_DELAY, value);
-      break;
-    default:
-      break;
+    return false;
+  }
+  else
+  {
+    return true;
   }
-  eUpdateCrc();
 }
 
 //*************************************************************************
-byte kGetDelayTimings(byte item)
+bool kGetXtResetKb()
 {
   byte value = 0;
 
-  switch(item)
+  eGet(E_XT_RESET_KB, value);
+  return value != 0;
+}
+
+//*************************************************************************
+void kProfile(const byte value)
+{
+  if (value < K_PROFILES)
   {
-    case 1:
-      EEPROM.get(E_AT_BIT_DELAY, value);
-      break;
-    case 2:
-      EEPROM.get(E_AT_NEXT_DELAY, value);
-      break;
-    case 3:
-      EEPROM.get(E_AT_START_DELAY, value);
-      break;
-    case 4:
-      EEPROM.get(E_XT_BIT_DELAY, value);
-      break;
-    case 5:
-      EEPROM.get(E_XT_NEXT_DELAY, value);
-      break;
-    case 6:
-      EEPROM.get(E_XT_START_DELAY, value);
-      break;
-    default:
-      break;
+    ePut(E_PROFILE, value);
+    eUpdateCrc();
   }
-  return value;
 }
 
 //*************************************************************************
-void k101Enabled(const bool value)
+byte kGetProfile()
 {
-  if (value)
+  byte profile = 0;
+
+  eGet(E_PROFILE, profile);
+  if (profile >= K_PROFILES)
   {
-    ext_keys_enabled = 1;
+    profile = K_DEF_PROFILE;
   }
-  else
+  return profile;
+}
+
+//*************************************************************************
+void kProfileName(const String name)
+{
+  int address = kProfileAddress(kGetProfile()) + offsetof(struct kb_profile, name);
+
+  for (byte i = 0; i < K_PROFILE_NAME; i++)
   {
-    ext_keys_enabled = 0;
+    ePut(address + i, (char) (i < name.length() ? name.charAt(i) : 0));
   }
-  EEPROM.put(E_EXT_KEYS_ENABLED, ext_keys_enabled);
   eUpdateCrc();
 }
 
 //*************************************************************************
-bool kGet101Enabled()
+void kGetProfileData(const byte profile, struct kb_profile &data)
 {
-  EEPROM.get(E_EXT_KEYS_ENABLED, ext_keys_enabled);
-  if (ext_keys_enabled == 0)
+  eGet(kProfileAddress(profile < K_PROFILES ? profile : K_DEF_PROFILE), data);
+}
+
+//*************************************************************************
+void kResetProfiles()
+{
+  struct kb_profile data;
+
+  data.timings.at_bit_delay = K_DEF_AT_BIT_DELAY;
+  data.timings.at_next_delay = K_DEF_AT_NEXT_DELAY;
+  data.timings.at_start_delay = K_DEF_AT_START_DELAY;
+  data.timings.xt_bit_delay = K_DEF_XT_BIT_DELAY;
+  data.timings.xt_next_delay = K_DEF_XT_NEXT_DELAY;
+  data.timings.xt_start_delay = K_DEF_XT_START_DELAY;
+  data.flags = K_DEF_EXT_KEYS_ENABLED ? K_PF_EXT_101 : 0;
+
+  for (byte i = 0; i < K_PROFILES; i++)
   {
-    return false;
+    memset(data.name, 0, K_PROFILE_NAME);
+    strcpy(data.name, "profile");
+    data.name[7] = '0' + i;
+    ePut(kProfileAddress(i), data);
   }
-  else
+  ePut(E_PROFILE, (byte) K_DEF_PROFILE);
+}
+
+//*************************************************************************
+bool kGetKbId()
+{
+  byte value = 0;
+
+  eGet(E_KB_ID, value);
+  return value != 0;
+}
+
+//*************************************************************************
+static int kModelAddress(const byte index)
+{
+  return E_MODELS + (index * K_MODEL_SIZE);
+}
+
+//*************************************************************************
+byte kFindModel(const unsigned int id, const byte clock, struct kb_model &model)
+{
+  for (byte i = 0; i < K_MODELS; i++)
   {
-    return true;
+    eGet(kModelAddress(i), model);
+    if (model.id == id && abs((int) model.clock - (int) clock) <= K_MODEL_CLOCK)
+    {
+      return i;
+    }
+  }
+  return K_MODELS;
+}
+
+//*************************************************************************
+void kGetModel(const byte index, struct kb_model &model)
+{
+  eGet(kModelAddress(index < K_MODELS ? index : 0), model);
+}
+
+//*************************************************************************
+bool kSaveModel(const struct kb_model &model)
+{
+  struct kb_model data;
+  byte index = kFindModel(model.id, model.clock, data);
+
+  // Replace the same model, otherwise use the first unused entry
+  if (index >= K_MODELS)
+  {
+    for (index = 0; index < K_MODELS; index++)
+    {
+      kGetModel(index, data);
+      if (data.id == K_NO_MODEL)
+      {
+        break;
+      }
+    }
+    if (index >= K_MODELS)
+    {
+      return false;
+    }
+  }
+  ePut(kModelAddress(index), model);
+  eUpdateCrc();
+  return true;
+}
+
+//*************************************************************************
+void kResetModels()
+{
+  struct kb_model data;
+
+  memset(&data, 0, sizeof(data));
+  data.id = K_NO_MODEL;
+  for (byte i = 0; i < K_MODELS; i++)
+  {
+    ePut(kModelAddress(i), data);
   }
 }
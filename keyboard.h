@@ -17,17 +17,67 @@
  * expressed or implied.
  */
 
+// Keyboard interface delay timings in uSecs
+struct kb_timings
+{
+  byte at_bit_delay;
+  byte at_next_delay;
+  byte at_start_delay;
+  byte xt_bit_delay;
+  byte xt_next_delay;
+  byte xt_start_delay;
+};
+
+// A named set of timings and features as stored in the EEPROM
+struct kb_profile
+{
+  char name[K_PROFILE_NAME];
+  struct kb_timings timings;
+  byte flags;
+};
+
+// The AT timings proven for a keyboard model, found by its 0xF2 ID and
+// clock period
+struct kb_model
+{
+  unsigned int id;
+  byte clock;                   // uSecs per clock period
+  byte at_bit_delay;
+  byte at_next_delay;
+  byte at_start_delay;
+};
+
 byte AT2XT(byte);
 byte AT2XTExt(byte);
 byte AT2XTExtNav(byte);
 byte AT2XTExtStrip(byte);
+byte XT2AT(byte);
+byte XT2ATExt(byte);
+byte ASCII2XT(char);
+
+// Set in an ASCII2XT() code typed with shift
+#define K_SHIFT                 0x80
 
-void kBoardType(const unsigned int value);
 unsigned int kGetBoardType();
-void kDelayTimings(byte value, byte item);
-byte kGetDelayTimings(byte item);
 
-void k101Enabled(const bool value);
-bool kGet101Enabled();
+bool kGetLedShow();
+bool kGetXtResetKb();
+
+void kProfile(const byte value);
+byte kGetProfile();
+int kProfileAddress(const byte profile);
+void kProfileName(const String name);
+void kGetProfileData(const byte profile, struct kb_profile &data);
+void kResetProfiles();
+
+// Defined in PS2KBTool.ino. Loads the selected profile into the timings
+// and flags in use, call after the profile or its settings are changed.
+void kLoadProfile();
+
+bool kGetKbId();
+byte kFindModel(const unsigned int id, const byte clock, struct kb_model &model);
+void kGetModel(const byte index, struct kb_model &model);
+bool kSaveModel(const struct kb_model &model);
+void kResetModels();
 
 #endif // _KEYBOARD_H_
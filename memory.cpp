@@ -0,0 +1,165 @@
+/*
+ * memory.cpp
+ * 
+ * SRAM usage. The free RAM between the top of the heap and the stack is
+ * filled with MEM_PAINT at boot. Whatever paint is left later on marks
+ * RAM that neither the stack nor the heap have reached.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+*/
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "memory.h"
+#include "serial_utils.h"
+
+#define MEM_MAGIC               0x3E3E
+#define MEM_PAINT               0xC5
+
+// Bytes below the stack pointer left unpainted for memInit()'s own calls
+#define MEM_GUARD               16
+
+// avr-libc malloc internals
+struct __freelist
+{
+  size_t sz;
+  struct __freelist *nx;
+};
+
+extern char __heap_start;
+extern char *__brkval;
+extern struct __freelist *__flp;
+
+struct mem_peaks
+{
+  unsigned int magic;
+  unsigned int stack_peak;      // Peak stack use in bytes of the previous run
+  unsigned int heap_peak;       // Peak heap size in bytes of the previous run
+};
+
+static struct mem_peaks mem_last __attribute__((section(".noinit")));
+
+//*************************************************************************
+static char *memHeapTop()
+{
+  return __brkval == 0 ? &__heap_start : __brkval;
+}
+
+//*************************************************************************
+// Finds the longest run of paint between the heap and the stack. Its
+// start is the heap high water mark and its end the stack low water mark.
+static void memScan(unsigned int &stack_peak, unsigned int &heap_peak)
+{
+  char *p = memHeapTop();
+  char *end = (char *) SP;
+  char *run_start = p;
+  char *best_start = p;
+  unsigned int best_len = 0;
+
+  for (; p < end; p++)
+  {
+    if ((byte) *p != MEM_PAINT)
+    {
+      run_start = p + 1;
+    }
+    else if ((unsigned int) (p - run_start + 1) > best_len)
+    {
+      best_start = run_start;
+      best_len = p - run_start + 1;
+    }
+  }
+
+  if (best_len == 0)
+  {
+    best_start = end;
+  }
+  heap_peak = best_start - &__heap_start;
+  stack_peak = (char *) RAMEND - (best_start + best_len) + 1;
+}
+
+//*************************************************************************
+void memInit()
+{
+  char *p;
+  char *end;
+
+  if (mem_last.magic == MEM_MAGIC)
+  {
+    memScan(mem_last.stack_peak, mem_last.heap_peak);
+  }
+  else
+  {
+    mem_last.stack_peak = 0;
+    mem_last.heap_peak = 0;
+  }
+  mem_last.magic = MEM_MAGIC;
+
+  end = (char *) SP - MEM_GUARD;
+  for (p = memHeapTop(); p < end; p++)
+  {
+    *p = MEM_PAINT;
+  }
+}
+
+//*************************************************************************
+unsigned int memFree()
+{
+  unsigned int free_ram = (char *) SP - memHeapTop();
+
+  for (struct __freelist *block = __flp; block != 0; block = block->nx)
+  {
+    free_ram += block->sz + sizeof(size_t);
+  }
+  return free_ram;
+}
+
+//*************************************************************************
+void memPrint()
+{
+  unsigned int free_ram = memFree();
+  unsigned int largest = (char *) SP - memHeapTop();
+  unsigned int stack_peak;
+  unsigned int heap_peak;
+
+  for (struct __freelist *block = __flp; block != 0; block = block->nx)
+  {
+    if (block->sz + sizeof(size_t) > largest)
+    {
+      largest = block->sz + sizeof(size_t);
+    }
+  }
+
+  memScan(stack_peak, heap_peak);
+
+  sHostPrint(F("MEM,free,"));
+  sHostPrintNum(free_ram, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,largest,"));
+  sHostPrintNum(largest, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,frag,"));
+  sHostPrintNum(free_ram ? 100 - ((unsigned long) largest * 100 / free_ram) : 0, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,stack_peak,"));
+  sHostPrintNum(stack_peak, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,heap_peak,"));
+  sHostPrintNum(heap_peak, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,last_stack_peak,"));
+  sHostPrintNum(mem_last.stack_peak, DEC);
+  sHostPrintln();
+  sHostPrint(F("MEM,last_heap_peak,"));
+  sHostPrintNum(mem_last.heap_peak, DEC);
+  sHostPrintln();
+}
@@ -0,0 +1,48 @@
+#ifndef _MEMORY_H_
+#define _MEMORY_H_
+
+/*
+ * memory.h
+ * 
+ * SRAM usage. Free RAM is painted at boot so the peak stack and heap use
+ * can be read back later, including the peaks of the previous run which
+ * are measured before repainting.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+/*************************************************************************
+ * memInit
+ * 
+ * Measures the peak stack and heap use of the previous run from the old
+ * paint, then paints the free RAM between the heap and the stack. Call
+ * first thing in setup().
+ *************************************************************************/
+void memInit();
+
+/*************************************************************************
+ * memFree
+ * 
+ * Returns the free RAM in bytes, being the gap between the heap and the
+ * stack plus the heap free list.
+ *************************************************************************/
+unsigned int memFree();
+
+/*************************************************************************
+ * memPrint
+ * 
+ * Prints MEM,<name>,<value> lines for the free RAM, largest free block,
+ * heap fragmentation and the peak stack and heap use of this and the
+ * previous run to the host serial port.
+ *************************************************************************/
+void memPrint();
+
+#endif // _MEMORY_H_
@@ -0,0 +1,356 @@
+/*
+ * mouse.cpp
+ * 
+ * PS/2 mouse to Microsoft serial mouse conversion.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#include "globals.h"
+
+#include "eeprom_utils.h"
+#include "mouse.h"
+
+// PS/2 mouse packet byte 0 bits
+#define M_LEFT                  0x01
+#define M_RIGHT                 0x02
+#define M_ALWAYS_1              0x08
+#define M_X_SIGN                0x10
+#define M_Y_SIGN                0x20
+#define M_X_OVERFLOW            0x40
+#define M_Y_OVERFLOW            0x80
+
+// Mouse start up states
+#define M_STATE_OFF             0       // Mouse not responding
+#define M_STATE_RESET           1       // 0xFF sent, waiting for the BAT
+#define M_STATE_ID              2       // BAT received, waiting for the mouse ID
+#define M_STATE_ENABLE          3       // 0xF4 sent, waiting for the ACK
+#define M_STATE_STREAMING       4       // Converting mouse packets
+
+static volatile bool m_streaming      = false;
+static volatile bool m_byte_ready     = false;
+static volatile bool m_changed        = false;
+
+static volatile byte m_buttons        = 0;
+static volatile byte m_clk_count      = 0;
+static volatile byte m_data_byte      = 0;
+static volatile byte m_packet[3];
+static volatile byte m_packet_index   = 0;
+
+static volatile int m_dx              = 0;
+static volatile int m_dy              = 0;
+
+static volatile unsigned int m_edge_time = 0;
+
+static byte m_sent_buttons            = 0;
+static byte m_state                   = M_STATE_OFF;
+
+static unsigned long m_state_time     = 0;
+
+//*************************************************************************
+static bool mWaitClk(const byte level)
+{
+  unsigned long start_time = micros();
+
+  while (digitalRead(MS_CLK) != level)
+  {
+    if ((micros() - start_time) > M_CLK_TIMEOUT)
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//*************************************************************************
+static bool mSend(const byte value)
+{
+  byte parity = 1;
+  bool ret_val = true;
+
+  // Stop the receiver seeing our own clock pulses
+  *digitalPinToPCMSK(MS_CLK) &= ~_BV(digitalPinToPCMSKbit(MS_CLK));
+
+  // Request to send: hold the clock low then take the data line low
+  pinMode(MS_CLK, OUTPUT);
+  digitalWrite(MS_CLK, LOW);
+  delayMicroseconds(M_INHIBIT_DELAY);
+  pinMode(MS_DATA, OUTPUT);
+  digitalWrite(MS_DATA, LOW);
+  pinMode(MS_CLK, INPUT_PULLUP);
+
+  // Data bits, LSB first, changed while the mouse holds the clock low
+  for (byte i = 0; i < 8 && ret_val; i++)
+  {
+    ret_val = mWaitClk(LOW);
+    digitalWrite(MS_DATA, bitRead(value, i));
+    parity ^= bitRead(value, i);
+    ret_val = ret_val && mWaitClk(HIGH);
+  }
+
+  // Odd parity bit then release the data line for the stop bit
+  ret_val = ret_val && mWaitClk(LOW);
+  digitalWrite(MS_DATA, parity);
+  ret_val = ret_val && mWaitClk(HIGH);
+  ret_val = ret_val && mWaitClk(LOW);
+  pinMode(MS_DATA, INPUT_PULLUP);
+  ret_val = ret_val && mWaitClk(HIGH);
+
+  // Line acknowledge from the mouse
+  ret_val = ret_val && mWaitClk(LOW);
+  ret_val = ret_val && mWaitClk(HIGH);
+
+  m_clk_count = 0;
+  m_byte_ready = false;
+  *digitalPinToPCMSK(MS_CLK) |= _BV(digitalPinToPCMSKbit(MS_CLK));
+  return ret_val;
+}
+
+//*************************************************************************
+static void mAddPacket(void)
+{
+  int dx = m_packet[1];
+  int dy = m_packet[2];
+
+  if (m_packet[0] & M_X_SIGN)
+  {
+    dx -= 256;
+  }
+  if (m_packet[0] & M_Y_SIGN)
+  {
+    dy -= 256;
+  }
+
+  // Discard the movement if the mouse's counters overflowed
+  if (!(m_packet[0] & (M_X_OVERFLOW | M_Y_OVERFLOW)))
+  {
+    m_dx += dx;
+    // PS/2 is positive up, the serial mouse is positive down
+    m_dy -= dy;
+  }
+  m_buttons = m_packet[0] & (M_LEFT | M_RIGHT);
+  m_changed = true;
+}
+
+//*************************************************************************
+// MS_CLK (D14) is PCINT8 on port C
+ISR(PCINT1_vect)
+{
+  static unsigned int now;
+
+  // Only the falling edges of the clock are of interest
+  if (digitalRead(MS_CLK))
+  {
+    return;
+  }
+
+  // Resynchronise if it has been too long since the last clock edge
+  now = (unsigned int) micros();
+  if (m_clk_count > 0 && (unsigned int) (now - m_edge_time) > AT_BIT_TIMEOUT)
+  {
+    m_clk_count = 0;
+  }
+  m_edge_time = now;
+
+  m_clk_count++;
+  if (m_clk_count == 1)
+  {
+    m_data_byte = 0;
+  }
+  else if (m_clk_count < 10)
+  {
+    if (digitalRead(MS_DATA))
+    {
+      bitSet(m_data_byte, m_clk_count - 2);
+    }
+  }
+  else if (m_clk_count >= 11)
+  {
+    m_clk_count = 0;
+    if (!m_streaming)
+    {
+      m_byte_ready = true;
+      return;
+    }
+
+    // Byte 0 always has bit 3 set, use it to keep packets aligned
+    if (m_packet_index == 0 && !(m_data_byte & M_ALWAYS_1))
+    {
+      return;
+    }
+    m_packet[m_packet_index++] = m_data_byte;
+    if (m_packet_index >= 3)
+    {
+      m_packet_index = 0;
+      mAddPacket();
+    }
+  }
+}
+
+//*************************************************************************
+bool mInit()
+{
+  S_HOST.begin(M_BAUD, SERIAL_7N1);
+
+  pinMode(MS_CLK, INPUT_PULLUP);
+  pinMode(MS_DATA, INPUT_PULLUP);
+
+  m_streaming = false;
+  m_clk_count = 0;
+  m_packet_index = 0;
+
+  // Enable the pin change interrupt on the mouse clock
+  *digitalPinToPCICR(MS_CLK) |= _BV(digitalPinToPCICRbit(MS_CLK));
+  *digitalPinToPCMSK(MS_CLK) |= _BV(digitalPinToPCMSKbit(MS_CLK));
+
+  // Reset the mouse. The rest of the start up is handled by mStartUp()
+  // so the keyboard is not held up waiting for the mouse self test.
+  m_state_time = millis();
+  if (mSend(0xFF))
+  {
+    m_state = M_STATE_RESET;
+    return true;
+  }
+  m_state = M_STATE_OFF;
+  return false;
+}
+
+//*************************************************************************
+static void mStartUp(void)
+{
+  if (!m_byte_ready)
+  {
+    if ((millis() - m_state_time) >= M_REPLY_TIMEOUT)
+    {
+      // The ID byte is optional, anything else means no mouse
+      if (m_state == M_STATE_ID)
+      {
+        m_state_time = millis();
+        m_state = mSend(0xF4) ? M_STATE_ENABLE : M_STATE_OFF;
+      }
+      else
+      {
+        m_state = M_STATE_OFF;
+      }
+    }
+    return;
+  }
+  m_byte_ready = false;
+
+  switch(m_state)
+  {
+    case M_STATE_RESET:
+      if (m_data_byte == 0xAA)
+      {
+        m_state_time = millis();
+        m_state = M_STATE_ID;
+      }
+      break;
+
+    case M_STATE_ID:
+      // Turn on data reporting
+      m_state_time = millis();
+      m_state = mSend(0xF4) ? M_STATE_ENABLE : M_STATE_OFF;
+      break;
+
+    case M_STATE_ENABLE:
+      if (m_data_byte == 0xFA)
+      {
+        m_streaming = true;
+        m_state = M_STATE_STREAMING;
+
+        // Identify as a Microsoft serial mouse
+        S_HOST.write('M');
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+
+//*************************************************************************
+void mProcess()
+{
+  int dx;
+  int dy;
+  byte buttons;
+
+  if (m_state != M_STATE_STREAMING)
+  {
+    if (m_state != M_STATE_OFF)
+    {
+      mStartUp();
+    }
+    return;
+  }
+
+  if (!m_changed)
+  {
+    return;
+  }
+
+  // Wait until the previous packet has gone so that the newest movement
+  // is sent rather than queueing up behind old packets.
+  if (S_HOST.availableForWrite() < (SERIAL_TX_BUFFER_SIZE - 1))
+  {
+    return;
+  }
+
+  noInterrupts();
+  dx = constrain(m_dx, -128, 127);
+  dy = constrain(m_dy, -128, 127);
+  m_dx -= dx;
+  m_dy -= dy;
+  buttons = m_buttons;
+  m_changed = (m_dx != 0 || m_dy != 0);
+  interrupts();
+
+  if (dx == 0 && dy == 0 && buttons == m_sent_buttons)
+  {
+    return;
+  }
+  m_sent_buttons = buttons;
+
+  // Microsoft serial mouse packet: 1 L R Y7 Y6 X7 X6, 0 X5..X0, 0 Y5..Y0
+  S_HOST.write(0x40 |
+               ((buttons & M_LEFT) ? 0x20 : 0) |
+               ((buttons & M_RIGHT) ? 0x10 : 0) |
+               ((dy >> 4) & 0x0C) |
+               ((dx >> 6) & 0x03));
+  S_HOST.write(dx & 0x3F);
+  S_HOST.write(dy & 0x3F);
+}
+
+//*************************************************************************
+bool mPending()
+{
+  return m_changed;
+}
+
+//*************************************************************************
+bool mGetEnabled()
+{
+  byte value = 0;
+
+  eGet(E_MOUSE_ENABLED, value);
+  if (value == 0)
+  {
+    return false;
+  }
+  else
+  {
+    return true;
+  }
+}
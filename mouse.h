@@ -0,0 +1,63 @@
+#ifndef _MOUSE_H_
+#define _MOUSE_H_
+
+/*
+ * mouse.h
+ * 
+ * PS/2 mouse to Microsoft serial mouse conversion.
+ * 
+ * A PS/2 mouse is read on the spare MS_CLK/MS_DATA pins and converted to
+ * 3 byte Microsoft serial mouse packets sent to the XT host on the serial
+ * port at 1200 baud 7N1. As the MS_CLK/MS_DATA pins are the option
+ * switches on the DEV board, the mouse can only be used on the standard
+ * and NuXT boards, and the serial debug output is turned off while the
+ * mouse is enabled.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+/*************************************************************************
+ * mInit
+ * 
+ * Starts the serial port for the serial mouse protocol and resets the
+ * PS/2 mouse. The mouse's data reporting is enabled from mProcess() once
+ * it has finished its self test, so this does not wait for the mouse.
+ * Returns false if the mouse did not respond.
+ *************************************************************************/
+bool mInit();
+
+/*************************************************************************
+ * mProcess
+ * 
+ * Steps the mouse start up, then sends a serial mouse packet if the mouse has moved or a button has
+ * changed and the serial port has finished sending the previous packet.
+ * Movement received while a packet is being sent is added together so
+ * only the newest position is sent rather than a growing backlog.
+ *************************************************************************/
+void mProcess();
+
+/*************************************************************************
+ * mPending
+ * 
+ * Returns true if there is mouse movement or a button change that has
+ * not been sent yet.
+ *************************************************************************/
+bool mPending();
+
+/*************************************************************************
+ * mGetEnabled
+ * 
+ * Returns true if the PS/2 to serial mouse conversion is turned on in
+ * EEPROM. It is set with the men command.
+ *************************************************************************/
+bool mGetEnabled();
+
+#endif // _MOUSE_H_
@@ -39,11 +39,15 @@
 
 // PS2KBTool pin definitions
 #define AT_CLK        D3
+#define AT_CLK_ICP    D8      // Timer1 input capture (ICP1) for AT_RX_INPUT_CAPTURE
 #define AT_DATA       D9
 
 #define XT_CLK        D11
 #define XT_DATA       D10
 
+#define MS_CLK        D14     // PS/2 mouse, shared with the DEV board option switches
+#define MS_DATA       D15
+
 #define CONFIG_1      D12
 #define DEV           D2
 
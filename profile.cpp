@@ -0,0 +1,235 @@
+/*
+ * profile.cpp
+ * 
+ * Hot path span profiler and main loop sampling profiler. The span table
+ * and sampler histogram are kept in RAM that is not cleared on reset, so
+ * the results of a run can be read back with the prof command after
+ * resetting into program mode.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+*/
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "profile.h"
+#include "serial_utils.h"
+
+#define PF_MAGIC                0x9F0F
+#define PF_SAMPLE_MAGIC         0x5A3F
+
+#ifdef PROFILE
+struct pf_entry
+{
+  unsigned long count;
+  unsigned long total;          // Timer1 ticks, saturates rather than wraps
+  unsigned int max;
+};
+
+struct pf_table
+{
+  unsigned int magic;
+  struct pf_entry spans[PF_SPANS];
+};
+
+static const char pf_names[PF_SPANS][11] PROGMEM =
+{
+  "at_rx",
+  "key_press",
+  "ext_key",
+  "send_xt",
+  "send_at",
+  "led_status"
+};
+
+static struct pf_table pf __attribute__((section(".noinit")));
+
+// Only set by pfStart(). Timer1 is not set up to time spans in program
+// mode, so the replay and benchmarks run there do not record them.
+static bool pf_recording = false;
+#endif // PROFILE
+
+#ifdef PROFILE_SAMPLER
+struct pf_histogram
+{
+  unsigned int magic;
+  unsigned long samples[PF_STATES];
+};
+
+static const char pf_state_names[PF_STATES][10] PROGMEM =
+{
+  "idle",
+  "translate",
+  "xt_tx",
+  "at_tx",
+  "log",
+  "flow_wait",
+  "eeprom"
+};
+
+static struct pf_histogram pf_hist __attribute__((section(".noinit")));
+
+volatile byte pf_state = PF_ST_IDLE;
+
+//*************************************************************************
+ISR(TIMER2_COMPA_vect)
+{
+  pf_hist.samples[pf_state]++;
+}
+#endif // PROFILE_SAMPLER
+
+#ifdef PROFILE
+//*************************************************************************
+void pfRecord(const byte span, const unsigned int ticks)
+{
+  struct pf_entry *entry = &pf.spans[span];
+
+  if (!pf_recording)
+  {
+    return;
+  }
+
+  // Each span is only ever recorded from one context, either the AT
+  // receiver ISR or the main loop, so no locking is needed here.
+  if (entry->count != 0xFFFFFFFFUL)
+  {
+    entry->count++;
+  }
+  if (entry->total + ticks >= entry->total)
+  {
+    entry->total += ticks;
+  }
+  else
+  {
+    entry->total = 0xFFFFFFFFUL;
+  }
+  if (ticks > entry->max)
+  {
+    entry->max = ticks;
+  }
+}
+#endif // PROFILE
+
+//*************************************************************************
+void pfInit()
+{
+#ifdef PROFILE
+  if (pf.magic != PF_MAGIC)
+  {
+    pfClear();
+  }
+#endif
+#ifdef PROFILE_SAMPLER
+  if (pf_hist.magic != PF_SAMPLE_MAGIC)
+  {
+    pfClear();
+  }
+#endif
+}
+
+//*************************************************************************
+void pfClear()
+{
+#ifdef PROFILE
+  memset(&pf, 0, sizeof(pf));
+  pf.magic = PF_MAGIC;
+#endif
+#ifdef PROFILE_SAMPLER
+  noInterrupts();
+  memset(&pf_hist, 0, sizeof(pf_hist));
+  pf_hist.magic = PF_SAMPLE_MAGIC;
+  interrupts();
+#endif
+}
+
+//*************************************************************************
+void pfStart()
+{
+  pfClear();
+
+#ifdef PROFILE
+  pf_recording = true;
+#endif
+
+#if defined(PROFILE) && !defined(AT_RX_INPUT_CAPTURE)
+  // Normal mode, no prescaler. The input capture receiver sets its own
+  // Timer1 mode, which the spans are then timed with.
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = _BV(CS10);
+  TCCR1C = 0;
+  TIMSK1 = 0;
+  interrupts();
+#endif
+
+#ifdef PROFILE_SAMPLER
+  // Timer2 in CTC mode with a 1024 prescaler. Timer2 is otherwise only
+  // used for PWM on D3 and D11, which are the AT_CLK and XT_CLK lines.
+  noInterrupts();
+  TCCR2A = _BV(WGM21);
+  TCCR2B = _BV(CS22) | _BV(CS21) | _BV(CS20);
+  TCNT2 = 0;
+  OCR2A = PF_SAMPLE_OCR;
+  TIFR2 = _BV(OCF2A);
+  TIMSK2 = _BV(OCIE2A);
+  interrupts();
+#endif
+}
+
+//*************************************************************************
+void pfPrint()
+{
+#ifdef PROFILE
+  struct pf_entry *entry;
+
+  for (byte span = 0; span < PF_SPANS; span++)
+  {
+    entry = &pf.spans[span];
+
+    sHostPrint(F("PROF,"));
+    sHostPrint((const __FlashStringHelper *) pf_names[span]);
+    sHostPrint(',');
+    sHostPrintNum(entry->count, DEC);
+    sHostPrint(',');
+    sHostPrintNum(entry->count ? (entry->total / entry->count) * PF_TICK_CYCLES : 0, DEC);
+    sHostPrint(',');
+    sHostPrintNum((unsigned long) entry->max * PF_TICK_CYCLES, DEC);
+    sHostPrint(',');
+    sHostPrintNum(entry->total / (clockCyclesPerMicrosecond() * 1000UL / PF_TICK_CYCLES), DEC);
+    sHostPrintln();
+  }
+#endif
+
+#ifdef PROFILE_SAMPLER
+  unsigned long total = 0;
+
+  for (byte state = 0; state < PF_STATES; state++)
+  {
+    total += pf_hist.samples[state];
+  }
+
+  for (byte state = 0; state < PF_STATES; state++)
+  {
+    sHostPrint(F("SAMPLE,"));
+    sHostPrint((const __FlashStringHelper *) pf_state_names[state]);
+    sHostPrint(',');
+    sHostPrintNum(pf_hist.samples[state], DEC);
+    sHostPrint(',');
+    sHostPrintNum(total >= 100 ? pf_hist.samples[state] / (total / 100) : 0, DEC);
+    sHostPrintln();
+  }
+#endif
+
+#if !defined(PROFILE) && !defined(PROFILE_SAMPLER)
+  sHostPrintln(F(T_MSG_48));
+#endif
+}
@@ -0,0 +1,142 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*
+ * profile.h
+ * 
+ * Hot path span profiler and main loop sampling profiler. The span
+ * profiler is only built when PROFILE is defined in globals.h and the
+ * sampler when PROFILE_SAMPLER is, otherwise PF_SPAN() and PF_STATE()
+ * compile to nothing.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+// Span identifiers
+#define PF_AT_RX                0       // AT clock edge ISR
+#define PF_KEY_PRESS            1       // processKeyPress()
+#define PF_EXT_KEY              2       // processExtKey()
+#define PF_SEND_XT              3       // sendXtCode()
+#define PF_SEND_AT              4       // sendAtCode()
+#define PF_LED_STATUS           5       // updateLedStatus()
+#define PF_SPANS                6       // Always keep at the end
+
+// Sampler states
+#define PF_ST_IDLE              0       // Main loop polling or asleep
+#define PF_ST_TRANSLATE         1       // Translating a received AT byte
+#define PF_ST_XT_TX             2       // Sending to the XT host
+#define PF_ST_AT_TX             3       // Sending to the AT keyboard
+#define PF_ST_LOG               4       // Writing to the host serial port
+#define PF_ST_FLOW_WAIT         5       // Waiting for XON from the host
+#define PF_ST_EEPROM            6       // Writing to the EEPROM
+#define PF_STATES               7       // Always keep at the end
+
+// Sampler rate is 16MHz / 1024 / (PF_SAMPLE_OCR + 1), about 100Hz
+#define PF_SAMPLE_OCR           155
+
+// Timer1 runs at the CPU clock unless the AT receiver is using it for input
+// capture, which runs it at 2MHz
+#ifdef AT_RX_INPUT_CAPTURE
+#define PF_TICK_CYCLES          8
+#else
+#define PF_TICK_CYCLES          1
+#endif
+
+#ifdef PROFILE
+/*************************************************************************
+ * pfTicks
+ * 
+ * Reads Timer1. The read is made atomic as the 16 bit TEMP register is
+ * shared with the AT receiver ISR.
+ *************************************************************************/
+static inline unsigned int pfTicks() __attribute__((always_inline));
+static inline unsigned int pfTicks()
+{
+  byte sreg = SREG;
+  unsigned int ticks;
+
+  cli();
+  ticks = TCNT1;
+  SREG = sreg;
+  return ticks;
+}
+
+void pfRecord(const byte span, const unsigned int ticks);
+
+// Times the enclosing scope, including any early return. Spans must be
+// shorter than 65536 Timer1 ticks and include the time spent in any ISR
+// that interrupts them.
+struct pf_span
+{
+  byte span;
+  unsigned int start;
+
+  inline pf_span(const byte s) : span(s), start(pfTicks()) {}
+  inline ~pf_span() { pfRecord(span, pfTicks() - start); }
+};
+
+#define PF_SPAN(span)           pf_span pf_span_guard(span)
+#else
+#define PF_SPAN(span)
+#endif
+
+#ifdef PROFILE_SAMPLER
+extern volatile byte pf_state;
+
+// Sets the sampler state for the enclosing scope and restores the outer
+// state on the way out, so nested states are counted as the inner one.
+struct pf_state_guard
+{
+  byte outer;
+
+  inline pf_state_guard(const byte s) : outer(pf_state) { pf_state = s; }
+  inline ~pf_state_guard() { pf_state = outer; }
+};
+
+#define PF_STATE(state)         pf_state_guard pf_state_guard_(state)
+#else
+#define PF_STATE(state)
+#endif
+
+/*************************************************************************
+ * pfInit
+ * 
+ * Validates the span table after a reset. Call once from setup().
+ *************************************************************************/
+void pfInit();
+
+/*************************************************************************
+ * pfClear
+ * 
+ * Empties the span table and the sampler histogram.
+ *************************************************************************/
+void pfClear();
+
+/*************************************************************************
+ * pfStart
+ * 
+ * Clears the span table and sets Timer1 free running at the CPU clock,
+ * then starts the sampler on Timer2. Called when booting into run mode,
+ * before the AT receiver is started. Spans are not recorded until it has
+ * been called, so the table of the last run is kept in program mode.
+ *************************************************************************/
+void pfStart();
+
+/*************************************************************************
+ * pfPrint
+ * 
+ * Prints a PROF,<span>,<count>,<mean cycles>,<max cycles>,<total mSecs>
+ * line per span and a SAMPLE,<state>,<samples>,<percent> line per
+ * sampler state to the host serial port.
+ *************************************************************************/
+void pfPrint();
+
+#endif // _PROFILE_H_
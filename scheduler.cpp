@@ -0,0 +1,179 @@
+/*
+ * scheduler.cpp
+ * 
+ * Cooperative run mode task scheduler. Deadlines are kept in micros()
+ * and compared as differences so they keep working when it wraps.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "scheduler.h"
+#include "serial_utils.h"
+
+#define SCH_MAGIC               0x5C4D
+
+struct sch_stats
+{
+  unsigned long runs;           // Times the task was run
+  unsigned int max_wait;        // Longest uSecs the task waited once due
+  unsigned int max_run;         // Longest uSecs the task ran for
+};
+
+struct sch_record
+{
+  unsigned int magic;
+  byte count;                   // Tasks in the table the statistics are for
+  struct sch_stats tasks[SCH_TASKS];
+};
+
+struct sch_state
+{
+  unsigned long due;            // micros() the task can next run at
+  unsigned long ready;          // micros() the task was due, less any time asleep
+};
+
+static struct sch_record sch __attribute__((section(".noinit")));
+
+static struct sch_state sch_states[SCH_TASKS];
+static const struct sch_task *sch_tasks = NULL;
+static byte sch_count   = 0;
+static byte sch_current = 0;
+static bool sch_sleep   = false;        // The running task has called schSleep()
+
+//*************************************************************************
+void schInit(const struct sch_task *tasks, const byte count)
+{
+  sch_tasks = tasks;
+  sch_count = min(count, SCH_TASKS);
+
+  if (sch.magic != SCH_MAGIC || sch.count != sch_count)
+  {
+    memset(&sch, 0, sizeof(sch));
+    sch.magic = SCH_MAGIC;
+    sch.count = sch_count;
+  }
+}
+
+//*************************************************************************
+void schStart()
+{
+  unsigned long now = micros();
+
+  memset(sch.tasks, 0, sizeof(sch.tasks));
+  for (byte task = 0; task < sch_count; task++)
+  {
+    sch_states[task].due = now;
+    sch_states[task].ready = now;
+  }
+}
+
+//*************************************************************************
+void schRun()
+{
+  struct sch_state *state;
+  struct sch_stats *stats;
+  void (*run)(void);
+  unsigned long start;
+  unsigned long wait;
+  unsigned long end;
+
+  for (sch_current = 0; sch_current < sch_count; sch_current++)
+  {
+    state = &sch_states[sch_current];
+    start = micros();
+    if ((long) (start - state->due) < 0)
+    {
+      continue;
+    }
+
+    // The ready time can be after the start once time asleep is taken off
+    wait = (long) (start - state->ready) > 0 ? start - state->ready : 0;
+
+    sch_sleep = false;
+    run = (void (*)(void)) pgm_read_word(&sch_tasks[sch_current].run);
+    run();
+    end = micros();
+
+    // Due again straight away unless the task set a deadline
+    if (!sch_sleep)
+    {
+      state->due = end;
+    }
+    state->ready = state->due;
+
+    stats = &sch.tasks[sch_current];
+    if (stats->runs < 0xFFFFFFFF)
+    {
+      stats->runs++;
+    }
+    stats->max_wait = max(stats->max_wait, min(wait, 0xFFFF));
+    stats->max_run = max(stats->max_run, min(end - start, 0xFFFF));
+  }
+}
+
+//*************************************************************************
+void schSleep(const unsigned int usecs)
+{
+  if (sch_current < sch_count)
+  {
+    sch_states[sch_current].due = micros() + usecs;
+    sch_sleep = true;
+  }
+}
+
+//*************************************************************************
+void schSlept(const unsigned long usecs)
+{
+  for (byte task = 0; task < sch_count; task++)
+  {
+    sch_states[task].ready += usecs;
+  }
+}
+
+//*************************************************************************
+void schPrint()
+{
+  bool pass = true;
+
+  for (byte task = 0; task < sch_count; task++)
+  {
+    sHostPrint(F("SCH,"));
+    sHostPrint((const __FlashStringHelper *) sch_tasks[task].name);
+    sHostPrint(',');
+    sHostPrintNum(sch.tasks[task].runs, DEC);
+    sHostPrint(',');
+    sHostPrintNum(sch.tasks[task].max_wait, DEC);
+    sHostPrint(',');
+    sHostPrintNum(sch.tasks[task].max_run, DEC);
+    if (sch.tasks[task].max_wait > SCH_MAX_WAIT)
+    {
+      sHostPrintln(F(",FAIL"));
+      pass = false;
+    }
+    else
+    {
+      sHostPrintln(F(",PASS"));
+    }
+  }
+
+  if (pass)
+  {
+    sHostPrintln(F("SCH,result,PASS"));
+  }
+  else
+  {
+    sHostPrintln(F("SCH,result,FAIL"));
+  }
+}
@@ -0,0 +1,97 @@
+#ifndef _SCHEDULER_H_
+#define _SCHEDULER_H_
+
+/*
+ * scheduler.h
+ * 
+ * Cooperative run mode task scheduler.
+ * 
+ * The main loop runs a fixed table of tasks in order. A task never waits
+ * for anything, it keeps its own state, does what it can and returns so
+ * the next task can run. A task that has to wait a set time calls
+ * schSleep() and is skipped until that deadline has passed, instead of
+ * holding up every other task in a delay. The bit timing of the AT and XT
+ * frames is still made with delays as it is far too short to yield in.
+ * 
+ * How long each task was kept waiting once due and how long it ran for
+ * are recorded in RAM that is not cleared on reset, so that a task being
+ * starved by the others can be seen with the stats command after the run.
+ * A task kept waiting longer than SCH_MAX_WAIT once due fails the check.
+ * That is about five AT frames, so a task that is not run for longer is
+ * holding up the keyboard rather than just waiting its turn behind an XT
+ * or AT frame.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#define SCH_TASKS               8       // Max tasks in the table
+#define SCH_NAME_SIZE           8       // Task name length including the terminator
+#define SCH_MAX_WAIT            5000    // Longest uSecs a due task may wait before it is starved
+
+// A task table entry, the table is kept in flash
+struct sch_task
+{
+  char name[SCH_NAME_SIZE];
+  void (*run)(void);
+};
+
+/*************************************************************************
+ * schInit
+ * 
+ * Sets the PROGMEM table of 'count' tasks that schRun() runs and
+ * validates the task statistics of the last run. Call in setup() in both
+ * modes so that the statistics can be printed in program mode.
+ *************************************************************************/
+void schInit(const struct sch_task *tasks, const byte count);
+
+/*************************************************************************
+ * schStart
+ * 
+ * Clears the task statistics and makes every task due. Called when
+ * booting into run mode.
+ *************************************************************************/
+void schStart();
+
+/*************************************************************************
+ * schRun
+ * 
+ * Runs each task whose deadline has passed once, in table order. Call
+ * from the main loop.
+ *************************************************************************/
+void schRun();
+
+/*************************************************************************
+ * schSleep
+ * 
+ * Called by the running task to be skipped until 'usecs' uSecs from now.
+ * A task that does not call it is run again on the next schRun().
+ *************************************************************************/
+void schSleep(const unsigned int usecs);
+
+/*************************************************************************
+ * schSlept
+ * 
+ * Tells the scheduler the CPU was asleep for 'usecs' uSecs with nothing
+ * to do, so that the time is not counted as tasks being kept waiting.
+ *************************************************************************/
+void schSlept(const unsigned long usecs);
+
+/*************************************************************************
+ * schPrint
+ * 
+ * Prints SCH,<task>,<runs>,<max wait uSecs>,<max run uSecs>,<PASS|FAIL>
+ * lines for the last run to the host serial port, where a task FAILs if
+ * its max wait is over SCH_MAX_WAIT, followed by a SCH,result,<PASS|FAIL>
+ * summary line.
+ *************************************************************************/
+void schPrint();
+
+#endif // _SCHEDULER_H_
@@ -19,22 +19,48 @@
 
 #include "eeprom_utils.h"
 #include "globals.h"
+#include "profile.h"
 #include "serial_utils.h"
+#include "watchdog.h"
 
 bool control_c            = false;
+bool quiet                = false;
 bool s_serial_enabled     = true;
 
-byte in_byte;
 byte flow_control         = S_DEF_XON_XOFF;
 
+// Command line input. Completed lines are queued null terminated in a
+// ring so that a pasted script is not lost while earlier lines are being
+// processed.
+static bool s_xoff        = false;
+static char s_prev_rx     = 0;
+static char s_line[S_LINE_SIZE];
+static char s_last_line[S_LINE_SIZE];
+static byte s_line_len    = 0;
+static char s_queue[S_QUEUE_SIZE];
+static unsigned int s_queue_head  = 0;
+static unsigned int s_queue_tail  = 0;
+static unsigned int s_queue_count = 0;
+static bool s_queue_full  = false;
+static bool s_raw_input   = false;
+static bool s_line_input  = false;
+
+// Output formatted while quiet is written here instead of the UART
+static char s_sink[S_SINK_SIZE];
+static byte s_sink_len    = 0;
+
 unsigned int char_delay   = S_DEF_CHAR_DELAY;
 unsigned int line_delay   = S_DEF_LINE_DELAY;
 unsigned long baud_rate   = S_DEF_HOST_BAUD;
 
+static bool sHostWrite(const char c);
+static bool sHostNewLine();
+static void sHostPause(const unsigned int msecs);
+
 //*************************************************************************
 bool sHostBaudRate(const unsigned long value)
 {
-  EEPROM.get(E_HOST_BAUD, baud_rate);
+  eGet(E_HOST_BAUD, baud_rate);
   if (baud_rate != value)
   {
     if (value == 115200 ||
@@ -48,7 +74,7 @@ bool sHostBaudRate(const unsigned long value)
         value == 600 ||
         value == 300) {
       baud_rate = value;
-      EEPROM.put(E_HOST_BAUD, value);
+      ePut(E_HOST_BAUD, value);
       eUpdateCrc();
       return true;
     }
@@ -63,188 +89,388 @@ bool sHostBaudRate(const unsigned long value)
 //*************************************************************************
 unsigned long sHostGetBaudRate()
 {
-  EEPROM.get(E_HOST_BAUD, baud_rate);
+  eGet(E_HOST_BAUD, baud_rate);
   return baud_rate;
 }
 
 //*************************************************************************
-void sHostCharDelay(const unsigned int value)
+unsigned int sHostGetCharDelay()
+{
+  eGet(E_CHAR_DELAY, char_delay);
+  return char_delay;
+}
+
+//*************************************************************************
+unsigned int sHostGetLineDelay()
+{
+  eGet(E_LINE_DELAY, line_delay);
+  return line_delay;
+}
+
+//*************************************************************************
+bool sHostPrint(const String &message)
 {
-  EEPROM.get(E_CHAR_DELAY, char_delay);
-  if (char_delay != value)
+  control_c = false;
+  for (unsigned int i = 0; i < message.length(); i++)
   {
-    char_delay = value;
-    EEPROM.put(E_CHAR_DELAY, value);
-    eUpdateCrc();
+    if (!sHostWrite(message.charAt(i)))
+    {
+      return false;
+    }
   }
+  return true;
 }
 
 //*************************************************************************
-unsigned int sHostGetCharDelay()
+bool sHostPrint(const __FlashStringHelper *message)
 {
-  EEPROM.get(E_CHAR_DELAY, char_delay);
-  return char_delay;
+  PGM_P p = reinterpret_cast<PGM_P>(message);
+  char c;
+
+  control_c = false;
+  while ((c = pgm_read_byte(p++)) != 0)
+  {
+    if (!sHostWrite(c))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+//*************************************************************************
+bool sHostPrint(const char c)
+{
+  control_c = false;
+  return sHostWrite(c);
 }
 
 //*************************************************************************
-void sHostLineDelay(const unsigned int value)
+bool sHostPrintln(const String &message)
 {
-  EEPROM.get(E_LINE_DELAY, line_delay);
-  if (line_delay != value)
+  if (!sHostPrint(message))
   {
-    line_delay = value;
-    EEPROM.put(E_LINE_DELAY, value);
-    eUpdateCrc();
+    return false;
   }
+  return sHostNewLine();
 }
 
 //*************************************************************************
-unsigned int sHostGetLineDelay()
+bool sHostPrintln(const __FlashStringHelper *message)
 {
-  EEPROM.get(E_LINE_DELAY, line_delay);
-  return line_delay;
+  if (!sHostPrint(message))
+  {
+    return false;
+  }
+  return sHostNewLine();
 }
 
 //*************************************************************************
-bool sHostPrint(const String &message)
+bool sHostPrintln()
 {
   control_c = false;
-  for (unsigned int i = 0; i < message.length(); i++)
+  return sHostNewLine();
+}
+
+//*************************************************************************
+bool sHostPrintNum(const unsigned long value, const byte base)
+{
+  // Large enough for a 32 bit value in binary plus the terminator
+  char buffer[8 * sizeof(long) + 1];
+  char *p = buffer;
+
+  ultoa(value, buffer, base);
+  control_c = false;
+  while (*p != 0)
   {
-    if (S_HOST.available() > 0)
-    {
-      in_byte = sHostRead();
-      if (flow_control > 0 && in_byte == XOFF)
-      {
-        while (in_byte != XON)
-        {
-          if (S_HOST.available() > 0)
-          {
-            in_byte = sHostRead();
-            if (in_byte == CTRL_C)
-            {
-              control_c = true;
-            }
-          }
-        }
-      }
-      else
-      {
-        if (in_byte == CTRL_C)
-        {
-          control_c = true;
-        }
-      }
-    }
-    if (control_c)
+    if (!sHostWrite(*p++))
     {
       return false;
     }
-    S_HOST.print(message.charAt(i));
-    delay(char_delay);
   }
   return true;
 }
 
 //*************************************************************************
-bool sHostPrintln(const String &message)
+bool sHostPrintHex(const byte value)
 {
+  static const char hex_digits[] PROGMEM = "0123456789abcdef";
+
   control_c = false;
-  for (unsigned int i = 0; i < message.length(); i++)
+  if (!sHostWrite(pgm_read_byte(&hex_digits[value >> 4])))
+  {
+    return false;
+  }
+  return sHostWrite(pgm_read_byte(&hex_digits[value & 0x0F]));
+}
+
+//*************************************************************************
+static bool sHostWrite(const char c)
+{
+  if (quiet)
   {
-    if (S_HOST.available() > 0)
+    s_sink[s_sink_len] = c;
+    s_sink_len = (s_sink_len + 1) % S_SINK_SIZE;
+    return true;
+  }
+
+  PF_STATE(PF_ST_LOG);
+
+  // Keep reading the host input while sending so that pasted commands,
+  // XOFF and <ctrl>-c are not lost
+  sHostPoll();
+  if (s_xoff)
+  {
+    PF_STATE(PF_ST_FLOW_WAIT);
+    unsigned long start = millis();
+
+    WD_STATE(WD_XOFF);
+    while (s_xoff && !control_c)
     {
-      in_byte = sHostRead();
-      if (flow_control > 0 && in_byte == XOFF)
-      {
-        while (in_byte != XON)
-        {
-          if (S_HOST.available() > 0)
-          {
-            in_byte = sHostRead();
-            if (in_byte == CTRL_C)
-            {
-              control_c = true;
-            }
-          }
-        }
-      }
-      else
+      // Carry on sending if the XON has been lost. The wait is bounded
+      // so the watchdog can be kicked while in it.
+      if (millis() - start > S_XOFF_TIMEOUT)
       {
-        if (in_byte == CTRL_C)
-        {
-          control_c = true;
-        }
+        s_xoff = false;
+        wdTimeout(WD_XOFF);
+        break;
       }
+      wdKick();
+      sHostPoll();
     }
-    if (control_c)
-    {
-      return false;
-    }
-    S_HOST.print(message.charAt(i));
-    delay(char_delay);
+    WD_STATE(WD_LOOP);
+  }
+  if (control_c)
+  {
+    return false;
   }
-  S_HOST.println(""); 
-  delay(line_delay);
+  S_HOST.write(c);
+  sHostPause(char_delay);
   return true;
 }
 
 //*************************************************************************
-char sHostRead()
+// Ends a line with CR LF through sHostWrite() so that it is paced, flow
+// controlled and silenced like any other output, followed by the inter
+// line delay. Does not clear control_c so that a <ctrl>-c received while
+// sending the rest of the line is not lost.
+static bool sHostNewLine()
 {
-  static char byte_read;
-  byte_read = S_HOST.read();
-  return byte_read;
+  if (!sHostWrite('\r') || !sHostWrite('\n'))
+  {
+    return false;
+  }
+  if (!quiet)
+  {
+    sHostPause(line_delay);
+  }
+  return true;
 }
 
 //*************************************************************************
-void sHostXonXoff(const bool value)
+// Waits out the pacing delays for slow hosts. The host input keeps being
+// read until the deadline rather than stopping for the whole delay, and
+// the wait is bounded so the watchdog can be kicked while in it.
+static void sHostPause(const unsigned int msecs)
 {
-  if (value)
+  unsigned long start = millis();
+
+  while (millis() - start < msecs)
   {
-    flow_control = 1;
+    wdKick();
+    sHostPoll();
   }
-  else
+}
+
+//*************************************************************************
+// Echoes input without blocking. Echo is dropped rather than holding up
+// the reading of the input when the transmit buffer is full.
+static void sHostEcho(const char c)
+{
+  if (!quiet && S_HOST.availableForWrite() > 0)
   {
-    flow_control = 0;
+    S_HOST.write(c);
   }
-  EEPROM.put(E_XON_XOFF, flow_control);
-  eUpdateCrc();
 }
 
 //*************************************************************************
-bool sHostGetXonXoff()
+static void sHostQueueLine()
 {
-  EEPROM.get(E_XON_XOFF, flow_control);
-  if (flow_control == 0)
+  if (s_queue_count + s_line_len + 1 > S_QUEUE_SIZE)
   {
-    return false;
+    s_queue_full = true;
+    return;
   }
-  else
+
+  for (byte i = 0; i <= s_line_len; i++)
   {
-    return true;
+    s_queue[s_queue_head] = (i < s_line_len) ? s_line[i] : 0;
+    s_queue_head = (s_queue_head + 1) % S_QUEUE_SIZE;
+  }
+  s_queue_count += s_line_len + 1;
+
+  if (s_line_len > 0)
+  {
+    memcpy(s_last_line, s_line, s_line_len);
+    s_last_line[s_line_len] = 0;
+  }
+}
+
+//*************************************************************************
+void sHostPoll()
+{
+  char c;
+
+  // Received characters are left for another reader
+  if (s_raw_input)
+  {
+    return;
+  }
+
+  while (S_HOST.available() > 0)
+  {
+    c = sHostRead();
+
+    if (c == XOFF && flow_control > 0)
+    {
+      s_xoff = true;
+    }
+    else if (c == XON && flow_control > 0)
+    {
+      s_xoff = false;
+    }
+    else if (c == CTRL_C)
+    {
+      // Abandon any output and any commands that have not been run yet
+      control_c = true;
+      s_xoff = false;
+      s_queue_head = s_queue_tail = s_queue_count = 0;
+      s_line_len = 0;
+    }
+    else if (!s_line_input)
+    {
+      // Only flow control and <ctrl>-c are acted on in run mode
+    }
+    else if (c == '\n' || c == '\r')
+    {
+      // A CR LF pair ends a single line
+      if (!(c == '\n' && s_prev_rx == '\r'))
+      {
+        sHostEcho('\r');
+        sHostEcho('\n');
+        sHostQueueLine();
+        s_line_len = 0;
+      }
+    }
+    else if (c == BACK_SPACE)
+    {
+      if (s_line_len > 0)
+      {
+        s_line_len--;
+        sHostEcho(BACK_SPACE);
+        sHostEcho(' ');
+        sHostEcho(BACK_SPACE);
+      }
+    }
+    else if (c == UP_ARROW)
+    {
+      for (byte i = 0; s_last_line[i] != 0 && s_line_len < S_LINE_SIZE - 1; i++)
+      {
+        s_line[s_line_len++] = s_last_line[i];
+        sHostEcho(s_last_line[i]);
+      }
+    }
+    else if (s_line_len < S_LINE_SIZE - 1)
+    {
+      s_line[s_line_len++] = c;
+      sHostEcho(c);
+    }
+    s_prev_rx = c;
   }
 }
 
 //*************************************************************************
-void sHostEnabled(const bool value)
+bool sHostGetLine(String &line)
 {
-  if (value)
+  char c;
+
+  sHostPoll();
+
+  if (s_queue_full)
   {
-    s_serial_enabled = 1;
+    s_queue_full = false;
+    sHostPrintln(F(T_MSG_50));
+  }
+
+  if (s_queue_count == 0)
+  {
+    return false;
+  }
+
+  line = "";
+  do
+  {
+    c = s_queue[s_queue_tail];
+    s_queue_tail = (s_queue_tail + 1) % S_QUEUE_SIZE;
+    s_queue_count--;
+    if (c != 0)
+    {
+      line += c;
+    }
+  } while (c != 0);
+  return true;
+}
+
+//*************************************************************************
+char sHostRead()
+{
+  static char byte_read;
+  byte_read = S_HOST.read();
+  return byte_read;
+}
+
+//*************************************************************************
+bool sHostGetControlC()
+{
+  return control_c;
+}
+
+//*************************************************************************
+void sHostQuiet(const bool value)
+{
+  quiet = value;
+}
+
+//*************************************************************************
+void sHostRawInput(const bool value)
+{
+  s_raw_input = value;
+}
+
+//*************************************************************************
+void sHostLineInput(const bool value)
+{
+  s_line_input = value;
+}
+
+//*************************************************************************
+bool sHostGetXonXoff()
+{
+  eGet(E_XON_XOFF, flow_control);
+  if (flow_control == 0)
+  {
+    return false;
   }
   else
   {
-    s_serial_enabled = 0;
+    return true;
   }
-  EEPROM.put(E_SERIAL_ENABLED, s_serial_enabled);
-  eUpdateCrc();
 }
 
 //*************************************************************************
 bool sHostGetEnabled()
 {
-  EEPROM.get(E_SERIAL_ENABLED, s_serial_enabled);
+  eGet(E_SERIAL_ENABLED, s_serial_enabled);
   if (s_serial_enabled == 0)
   {
     return false;
@@ -254,3 +480,12 @@ bool sHostGetEnabled()
     return true;
   }
 }
+
+//*************************************************************************
+byte sHostGetLogMask()
+{
+  byte log_mask = 0;
+
+  eGet(E_LOG_MASK, log_mask);
+  return log_mask;
+}
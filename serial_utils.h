@@ -37,43 +37,27 @@ bool sHostBaudRate(const unsigned long value);
 unsigned long sHostGetBaudRate();
 
 /*************************************************************************
- * sHostCharDelay
+ * sHostGetCharDelay
  * 
- * Updates the time delay in mSecs between each character sent via the
- * sHostPrint() and sHostPrintln() functions.
+ * Returns the time delay in mSecs between each character sent via the
+ * sHostPrint() and sHostPrintln() functions, set with the scd command.
  *
  * On a model 100 using the TELCOM software, a minimum of 15 mSec delay is
  * required to receive all characters sent. Any shorter time period can
  * result in dropped characters.
  *************************************************************************/
-void sHostCharDelay(const unsigned int value);
-
-/*************************************************************************
- * sHostGetCharDelay
- * 
- * Returns the time delay in mSecs between each character sent via the
- * sHostPrint() and sHostPrintln() functions.
- *************************************************************************/
 unsigned int sHostGetCharDelay();
 
 /*************************************************************************
- * sHostLineDelay
+ * sHostGetLineDelay
  * 
- * Updates the time delay in mSecs at the end of a line of text sent via
- * the sHostPrintln() function.
+ * Returns the time delay in mSecs between each line of text sent via
+ * the sHostPrintln() function, set with the sld command.
  *
  * On a model 100 using the TELCOM software, a minimum of 150 mSec delay is
  * required to receive all characters sent. Any shorter time period can
  * result in the final carriage return not being received.
  *************************************************************************/
-void sHostLineDelay(const unsigned int value);
-
-/*************************************************************************
- * sHostGetLineDelay
- * 
- * Returns the time delay in mSecs between each line of text sent via
- * the sHostPrintln() function.
- *************************************************************************/
 unsigned int sHostGetLineDelay();
 
 /*************************************************************************
@@ -97,6 +81,51 @@ bool sHostPrint(const String &message);
  *************************************************************************/
 bool sHostPrintln(const String &message);
 
+/*************************************************************************
+ * sHostPrint / sHostPrintln (flash)
+ * 
+ * As above but streams the text directly from flash, e.g.
+ * sHostPrint(F(T_MSG_01)), without copying it into a String in SRAM.
+ *************************************************************************/
+bool sHostPrint(const __FlashStringHelper *message);
+bool sHostPrintln(const __FlashStringHelper *message);
+
+/*************************************************************************
+ * sHostPrint (char)
+ * 
+ * Sends a single character to the host serial port.
+ * Returns false if a <ctrl>-c is received during sending, otherwise
+ * returns true.
+ *************************************************************************/
+bool sHostPrint(const char c);
+
+/*************************************************************************
+ * sHostPrintln
+ * 
+ * Sends a carriage return to the host serial port followed by the inter
+ * line delay.
+ *************************************************************************/
+bool sHostPrintln();
+
+/*************************************************************************
+ * sHostPrintNum
+ * 
+ * Sends 'value' formatted in the number base 'base' (DEC, HEX etc.) to
+ * the host serial port without using a temporary String.
+ * Returns false if a <ctrl>-c is received during sending, otherwise
+ * returns true.
+ *************************************************************************/
+bool sHostPrintNum(const unsigned long value, const byte base);
+
+/*************************************************************************
+ * sHostPrintHex
+ * 
+ * Sends 'value' to the host serial port as 2 zero padded hex digits.
+ * Returns false if a <ctrl>-c is received during sending, otherwise
+ * returns true.
+ *************************************************************************/
+bool sHostPrintHex(const byte value);
+
 /*************************************************************************
  * sHostRead
  * 
@@ -108,33 +137,86 @@ bool sHostPrintln(const String &message);
 char sHostRead();
 
 /*************************************************************************
- * sHostXonXoff
+ * sHostPoll
+ * 
+ * Moves any received characters from the UART receive buffer into the
+ * command line, echoing them without blocking, and queues each completed
+ * line while sHostLineInput() is on. Also tracks XON/XOFF and <ctrl>-c,
+ * which empties the queue. Call
+ * often, it is also called while sending and while waiting for EEPROM
+ * writes, so pasted input keeps up with the full baud rate.
+ *************************************************************************/
+void sHostPoll();
+
+/*************************************************************************
+ * sHostGetLine
+ * 
+ * Takes the next queued command line into 'line'. Returns false if there
+ * are no lines waiting.
+ *************************************************************************/
+bool sHostGetLine(String &line);
+
+/*************************************************************************
+ * sHostGetControlC
+ * 
+ * Returns true if a <ctrl>-c has been received since the last of the
+ * sHostPrint functions was called. Call sHostPoll() to read the input.
+ *************************************************************************/
+bool sHostGetControlC();
+
+/*************************************************************************
+ * sHostQuiet
  * 
- * Turns on or off the Xon Xoff flow control. Pass in 'true' to turn on
- * or 'false' to turn off.
+ * Pass in 'true' to discard all output from the sHostPrint functions
+ * until called again with 'false'. Used when timing code that prints, the
+ * output is still formatted and written to a small RAM sink in place of
+ * the UART, without any pacing delays.
  *************************************************************************/
-void sHostXonXoff(const bool value);
+void sHostQuiet(const bool value);
+
+/*************************************************************************
+ * sHostRawInput
+ * 
+ * Pass in 'true' to stop sHostPoll() reading the host serial port, so
+ * that received characters are left for another reader such as the
+ * keystroke injection. XOFF, XON and <ctrl>-c are not acted on until
+ * called again with 'false'.
+ *************************************************************************/
+void sHostRawInput(const bool value);
+
+/*************************************************************************
+ * sHostLineInput
+ * 
+ * Pass in 'true' to have sHostPoll() echo the characters received and
+ * assemble them into the command lines returned by sHostGetLine(). Set in
+ * program mode only, otherwise only XOFF, XON and <ctrl>-c are acted on
+ * and other characters are discarded, so that output in run mode does
+ * not pay for reading command lines.
+ *************************************************************************/
+void sHostLineInput(const bool value);
 
 /*************************************************************************
  * sHostGetXonXoff
  * 
- * Returns the state of the Xon Xoff flow control.
+ * Returns the state of the Xon Xoff flow control, set with the sfc
+ * command.
  *************************************************************************/
 bool sHostGetXonXoff();
 
 /*************************************************************************
- * sHostEnabled
+ * sHostGetEnabled
  * 
- * Turns on or off serial communications. Pass in 'true' to turn on
- * or 'false' to turn off.
+ * Returns the state of the serial communications, set with the sen
+ * command.
  *************************************************************************/
-void sHostEnabled(const bool value);
+bool sHostGetEnabled();
 
 /*************************************************************************
- * sHostEnabled
+ * sHostGetLogMask
  * 
- * Returns the state of the serial communications.
+ * Returns the LOG_xxx categories written to the serial debug log, set
+ * with the slm command.
  *************************************************************************/
-bool sHostGetEnabled();
+byte sHostGetLogMask();
 
 #endif // _SERIAL_UTILS_H_
@@ -0,0 +1,229 @@
+/*
+ * stats.cpp
+ * 
+ * Run mode statistics.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <Arduino.h>
+
+#include "globals.h"
+
+#include "serial_utils.h"
+#include "stats.h"
+
+#define ST_MAGIC                0x57A7
+
+// Times are halved together when the total gets this large so that the
+// sleep fraction stays correct without overflowing.
+#define ST_TIME_LIMIT           0x80000000UL
+
+struct run_stats
+{
+  unsigned int magic;
+  unsigned long run_time;       // Total uSecs accounted for
+  unsigned long sleep_time;     // uSecs spent in idle sleep
+  unsigned int parity_errors;   // AT frames received with bad parity
+  unsigned int stop_errors;     // AT frames received with a bad stop bit
+  unsigned int timeouts;        // AT frames abandoned part way through
+  unsigned int late_samples;    // AT_DATA sampled too late after the clock edge
+  unsigned int frame_time;      // Start to stop bit of the last frame, AT_EDGE_TICKS per uSec
+  unsigned long boot_time;      // mSecs from reset to the end of setup()
+  unsigned long first_key;      // mSecs from reset to the first translated key
+  unsigned int xt_resets;       // Keyboard resets requested by the XT host
+  unsigned int kb_id;           // Keyboard 0xF2 ID, K_NO_MODEL if not identified
+  byte kb_clock;                // Keyboard clock period in uSecs when identified
+  byte kb_model;                // Model timings used, K_MODELS if none
+};
+
+static struct run_stats st __attribute__((section(".noinit")));
+
+static unsigned long st_last = 0;
+
+//*************************************************************************
+void stInit()
+{
+  if (st.magic != ST_MAGIC)
+  {
+    stClear();
+  }
+}
+
+//*************************************************************************
+void stClear()
+{
+  memset(&st, 0, sizeof(st));
+  st.magic = ST_MAGIC;
+  st.kb_id = K_NO_MODEL;
+  st.kb_model = K_MODELS;
+  st_last = micros();
+}
+
+//*************************************************************************
+void stAtError(const byte error)
+{
+  if (error & AT_PARITY_ERROR)
+  {
+    st.parity_errors++;
+  }
+  if (error & AT_STOP_ERROR)
+  {
+    st.stop_errors++;
+  }
+  if (error & AT_TIMEOUT_ERROR)
+  {
+    st.timeouts++;
+  }
+  if (error & AT_LATE_ERROR)
+  {
+    st.late_samples++;
+  }
+}
+
+//*************************************************************************
+void stAtClock(const unsigned int frame_time)
+{
+  st.frame_time = frame_time;
+}
+
+//*************************************************************************
+unsigned int stGetAtClock()
+{
+  unsigned int frame_time;
+
+  noInterrupts();
+  frame_time = st.frame_time;
+  interrupts();
+
+  // There are 10 clock periods from the start bit to the stop bit
+  return frame_time / (10 * AT_EDGE_TICKS);
+}
+
+//*************************************************************************
+void stKbId(const unsigned int id, const byte clock, const byte model)
+{
+  st.kb_id = id;
+  st.kb_clock = clock;
+  st.kb_model = model;
+}
+
+//*************************************************************************
+bool stGetKbId(unsigned int &id, byte &clock)
+{
+  id = st.kb_id;
+  clock = st.kb_clock;
+  return id != K_NO_MODEL;
+}
+
+//*************************************************************************
+void stBootDone()
+{
+  st.boot_time = millis();
+}
+
+//*************************************************************************
+void stFirstKey()
+{
+  if (st.first_key == 0)
+  {
+    st.first_key = millis();
+  }
+}
+
+//*************************************************************************
+void stXtReset()
+{
+  st.xt_resets++;
+}
+
+//*************************************************************************
+void stSleepTime(const unsigned long sleep_time)
+{
+  unsigned long now = micros();
+
+  st.run_time += now - st_last;
+  st.sleep_time += sleep_time;
+  st_last = now;
+
+  if (st.run_time >= ST_TIME_LIMIT)
+  {
+    st.run_time = st.run_time >> 1;
+    st.sleep_time = st.sleep_time >> 1;
+  }
+}
+
+//*************************************************************************
+void stPrint()
+{
+  unsigned long percent = 0;
+
+  if (st.run_time >= 100)
+  {
+    percent = st.sleep_time / (st.run_time / 100);
+  }
+
+  sHostPrint(F(T_MSG_42));
+  sHostPrintNum(st.boot_time, DEC);
+  sHostPrintln(F(" mSec"));
+  sHostPrint(F(T_MSG_43));
+  sHostPrintNum(st.first_key, DEC);
+  sHostPrintln(F(" mSec"));
+  sHostPrint(F(T_MSG_34));
+  sHostPrintNum(percent, DEC);
+  sHostPrintln(F(" %"));
+  sHostPrint(F(T_MSG_35));
+  sHostPrintNum(st.parity_errors, DEC);
+  sHostPrintln();
+  sHostPrint(F(T_MSG_36));
+  sHostPrintNum(st.stop_errors, DEC);
+  sHostPrintln();
+  sHostPrint(F(T_MSG_37));
+  sHostPrintNum(st.timeouts, DEC);
+  sHostPrintln();
+  sHostPrint(F(T_MSG_38));
+  sHostPrintNum(st.late_samples, DEC);
+  sHostPrintln();
+  sHostPrint(F(T_MSG_56));
+  sHostPrintNum(st.xt_resets, DEC);
+  sHostPrintln();
+
+  // There are 10 clock periods from the start bit to the stop bit, so the
+  // frame time in uSecs is the period in tenths of a uSec
+  sHostPrint(F(T_MSG_39));
+  sHostPrintNum(st.frame_time / AT_EDGE_TICKS / 10, DEC);
+  sHostPrint('.');
+  sHostPrintNum(st.frame_time / AT_EDGE_TICKS % 10, DEC);
+  sHostPrintln(F(" uSec"));
+
+  sHostPrint(F(T_MSG_58));
+  if (st.kb_id == K_NO_MODEL)
+  {
+    sHostPrintln(F(T_MSG_60));
+  }
+  else
+  {
+    sHostPrintNum(st.kb_id, HEX);
+    sHostPrint(F(", "));
+    sHostPrintNum(st.kb_clock, DEC);
+    sHostPrintln(F(" uSec"));
+  }
+  sHostPrint(F(T_MSG_59));
+  if (st.kb_model >= K_MODELS)
+  {
+    sHostPrintln(F(T_MSG_60));
+  }
+  else
+  {
+    sHostPrintNum(st.kb_model, DEC);
+    sHostPrintln();
+  }
+}
@@ -0,0 +1,105 @@
+#ifndef _STATS_H_
+#define _STATS_H_
+
+/*
+ * stats.h
+ * 
+ * Run mode statistics.
+ * 
+ * The statistics are kept in RAM that is not cleared on reset. They are
+ * cleared when booting into run mode so that after resetting into program
+ * mode the 'stats' command shows the figures from the last run.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+/*************************************************************************
+ * stInit
+ * 
+ * Validates the statistics after a reset. Call once from setup().
+ *************************************************************************/
+void stInit();
+
+/*************************************************************************
+ * stClear
+ * 
+ * Resets all of the statistics. Called when booting into run mode.
+ *************************************************************************/
+void stClear();
+
+/*************************************************************************
+ * stAtError
+ * 
+ * Counts each of the AT_xxx_ERROR bits set in 'error'. Safe to call from
+ * the AT clock ISR.
+ *************************************************************************/
+void stAtError(const byte error);
+
+/*************************************************************************
+ * stAtClock
+ * 
+ * Records the time from the start bit to the stop bit of the last
+ * received AT frame, in AT_EDGE_TICKS per uSec, used to report the
+ * keyboard clock period.
+ *************************************************************************/
+void stAtClock(const unsigned int frame_time);
+
+/*************************************************************************
+ * stGetAtClock
+ * 
+ * Returns the keyboard clock period in uSecs measured from the last
+ * received AT frame.
+ *************************************************************************/
+unsigned int stGetAtClock();
+
+/*************************************************************************
+ * stKbId / stGetKbId
+ * 
+ * Record the keyboard's 0xF2 ID and clock period, and the index of the
+ * model timings used or K_MODELS if none. stGetKbId() returns false if
+ * the keyboard was not identified in the last run.
+ *************************************************************************/
+void stKbId(const unsigned int id, const byte clock, const byte model);
+bool stGetKbId(unsigned int &id, byte &clock);
+
+/*************************************************************************
+ * stBootDone / stFirstKey
+ * 
+ * Record the time in mSecs from reset to the end of setup() and to the
+ * first translated key sent to the XT host. Only the first call to
+ * stFirstKey() after a reset is recorded.
+ *************************************************************************/
+void stBootDone();
+void stFirstKey();
+
+/*************************************************************************
+ * stXtReset
+ * 
+ * Counts a keyboard reset requested by the XT host.
+ *************************************************************************/
+void stXtReset();
+
+/*************************************************************************
+ * stSleepTime
+ * 
+ * Adds 'sleep_time' uSecs spent in idle sleep and updates the total run
+ * time.
+ *************************************************************************/
+void stSleepTime(const unsigned long sleep_time);
+
+/*************************************************************************
+ * stPrint
+ * 
+ * Prints the statistics to the host serial port.
+ *************************************************************************/
+void stPrint();
+
+#endif // _STATS_H_
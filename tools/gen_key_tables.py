@@ -0,0 +1,272 @@
+#!/usr/bin/env python3
+"""
+gen_key_tables.py
+
+Generates key_tables.h, the PROGMEM scan code translation tables, from the
+scan code spec in tools/keys.csv.
+
+  python3 tools/gen_key_tables.py          write key_tables.h
+  python3 tools/gen_key_tables.py --check  check the spec, check that
+                                           key_tables.h is up to date and
+                                           look every key in the spec up
+                                           through the generated tables
+
+This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+to use for non-commercial purposes.
+"""
+
+import csv
+import os
+import re
+import sys
+
+TOOLS_DIR = os.path.dirname(os.path.abspath(__file__))
+SPEC_FILE = os.path.join(TOOLS_DIR, "keys.csv")
+HEADER_FILE = os.path.join(TOOLS_DIR, "..", "key_tables.h")
+
+STD_SIZE = 0x84     # Set 2 codes run up to 0x83 (F7)
+EXT_SIZE = 0x80     # E0 prefixed set 2 codes and all set 1 codes are below 0x80
+BITS_SIZE = EXT_SIZE // 8
+ASCII_SIZE = 0x80   # 7 bit ASCII
+SHIFT = 0x80        # Set in kt_ascii for characters typed with shift
+
+# US layout characters typed with shift, by the key's unshifted character.
+# Keys named by a single character type it in lower case.
+SHIFTED = dict(zip("`1234567890-=[]\\;',./", '~!@#$%^&*()_+{}|:"<>?'))
+
+# Keys typed for control characters
+CONTROLS = {"Backspace": "\b", "Tab": "\t", "Enter": "\r", "Esc": "\x1b", "Space": " "}
+
+FLAGS = ("std", "ext", "nav", "strip")
+
+
+class SpecError(Exception):
+    pass
+
+
+def read_spec(path):
+    """Returns the spec rows as (line, key, set2, set1, flags, name) tuples."""
+    rows = []
+    with open(path, newline="") as f:
+        lines = [l for l in f if not l.startswith("#")]
+    reader = csv.DictReader(lines)
+    for line, row in enumerate(reader, start=2):
+        try:
+            key = int(row["key"])
+            set2 = int(row["set2"], 16)
+            set1 = int(row["set1"], 16)
+        except (TypeError, ValueError):
+            raise SpecError("line %d: bad number in %r" % (line, row))
+        flags = set(row["flags"].split("+"))
+        if not flags or not flags <= set(FLAGS):
+            raise SpecError("line %d: bad flags %r" % (line, row["flags"]))
+        if "std" in flags and len(flags) > 1:
+            raise SpecError("line %d: std can not be combined with other flags" % line)
+        if "ext" in flags and "nav" in flags:
+            raise SpecError("line %d: ext and nav are exclusive" % line)
+        limit = STD_SIZE if "std" in flags else EXT_SIZE
+        if set2 >= limit:
+            raise SpecError("line %d: set 2 code 0x%02X out of range" % (line, set2))
+        if set1 >= EXT_SIZE or set1 == 0:
+            raise SpecError("line %d: set 1 code 0x%02X out of range" % (line, set1))
+        rows.append((line, key, set2, set1, flags, row["name"]))
+    return rows
+
+
+def build_tables(rows):
+    """Builds the forward, reverse and flag tables from the spec rows."""
+    std = [0] * STD_SIZE
+    ext = [0] * EXT_SIZE
+    std_rev = [0] * EXT_SIZE
+    ext_rev = [0] * EXT_SIZE
+    bits = {flag: [0] * BITS_SIZE for flag in FLAGS[1:]}
+
+    for line, key, set2, set1, flags, name in rows:
+        if "std" in flags:
+            fwd, rev = std, std_rev
+        else:
+            fwd, rev = ext, ext_rev
+            for flag in flags:
+                bits[flag][set2 >> 3] |= 1 << (set2 & 7)
+
+        # The same code may be listed for more than one key position, e.g.
+        # \ and ISO #, but it must always translate the same way.
+        if fwd[set2] not in (0, set1):
+            raise SpecError("line %d: set 2 code 0x%02X already maps to 0x%02X"
+                            % (line, set2, fwd[set2]))
+        if rev[set1] not in (0, set2):
+            raise SpecError("line %d: set 1 code 0x%02X already maps to 0x%02X"
+                            % (line, set1, rev[set1]))
+        fwd[set2] = set1
+        rev[set1] = set2
+
+    return {
+        "kt_ascii": build_ascii(rows),
+        "kt_std": std,
+        "kt_ext": ext,
+        "kt_std_rev": std_rev,
+        "kt_ext_rev": ext_rev,
+        "kt_ext_bits": bits["ext"],
+        "kt_nav_bits": bits["nav"],
+        "kt_strip_bits": bits["strip"],
+    }
+
+
+def build_ascii(rows):
+    """Builds the ASCII to set 1 table used to type text into the XT host."""
+    ascii = [0] * ASCII_SIZE
+    for line, key, set2, set1, flags, name in rows:
+        # Only the main keys type text, ISO keys repeat US key codes
+        if "std" not in flags:
+            continue
+        if name in CONTROLS:
+            ascii[ord(CONTROLS[name])] = set1
+        elif len(name) == 1:
+            ascii[ord(name.lower())] = set1
+            shifted = name.upper() if name.isalpha() else SHIFTED.get(name)
+            if shifted:
+                ascii[ord(shifted)] = set1 | SHIFT
+    # A new line is typed as Enter
+    ascii[ord("\n")] = ascii[ord("\r")]
+    return ascii
+
+
+TABLE_COMMENTS = {
+    "kt_ascii": "ASCII to set 1 make code for typing text, KT_SHIFT set if shifted",
+    "kt_std": "Set 2 to set 1 for codes sent without a prefix",
+    "kt_ext": "Set 2 to set 1 for E0 prefixed codes",
+    "kt_std_rev": "Set 1 to set 2 for codes sent without a prefix",
+    "kt_ext_rev": "Set 1 to set 2 for E0 prefixed codes",
+    "kt_ext_bits": "E0 prefixed codes where the E0 is always passed on",
+    "kt_nav_bits": "E0 prefixed 101 key codes, the E0 is passed on when k101 is on",
+    "kt_strip_bits": "E0 prefixed codes where the E0 is dropped",
+}
+
+TABLE_SIZES = {
+    "kt_ascii": "KT_ASCII_SIZE",
+    "kt_std": "KT_STD_SIZE",
+    "kt_ext": "KT_EXT_SIZE",
+    "kt_std_rev": "KT_EXT_SIZE",
+    "kt_ext_rev": "KT_EXT_SIZE",
+    "kt_ext_bits": "KT_BITS_SIZE",
+    "kt_nav_bits": "KT_BITS_SIZE",
+    "kt_strip_bits": "KT_BITS_SIZE",
+}
+
+
+def render(tables, rows):
+    out = []
+    out.append("#ifndef _KEY_TABLES_H_")
+    out.append("#define _KEY_TABLES_H_")
+    out.append("")
+    out.append("/*")
+    out.append(" * key_tables.h")
+    out.append(" * ")
+    out.append(" * Scan code translation tables.")
+    out.append(" * ")
+    out.append(" * GENERATED by tools/gen_key_tables.py from tools/keys.csv (%d keys)."
+               % len(rows))
+    out.append(" * Do not edit, change the spec and regenerate instead.")
+    out.append(" * ")
+    out.append(" * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free")
+    out.append(" * to use for non-commercial purposes.")
+    out.append(" */")
+    out.append("")
+    out.append("#define KT_STD_SIZE             0x%02X" % STD_SIZE)
+    out.append("#define KT_EXT_SIZE             0x%02X" % EXT_SIZE)
+    out.append("#define KT_BITS_SIZE            %d" % BITS_SIZE)
+    out.append("#define KT_ASCII_SIZE           0x%02X" % ASCII_SIZE)
+    out.append("#define KT_SHIFT                0x%02X" % SHIFT)
+    out.append("")
+    out.append("// Tests bit 'code' of a PROGMEM bitset")
+    out.append("#define KT_BIT(bits, code)      (pgm_read_byte(&(bits)[(code) >> 3]) & (1 << ((code) & 7)))")
+    for name in TABLE_COMMENTS:
+        values = tables[name]
+        out.append("")
+        out.append("// " + TABLE_COMMENTS[name])
+        out.append("static const byte %s[%s] PROGMEM =" % (name, TABLE_SIZES[name]))
+        out.append("{")
+        for i in range(0, len(values), 16):
+            chunk = ", ".join("0x%02X" % v for v in values[i:i + 16])
+            sep = "," if i + 16 < len(values) else ""
+            out.append("  %s%s" % (chunk, sep))
+        out.append("};")
+    out.append("")
+    out.append("#endif // _KEY_TABLES_H_")
+    return "\n".join(out) + "\n"
+
+
+def parse_header(text):
+    """Reads the tables back out of a generated header."""
+    tables = {}
+    for m in re.finditer(r"static const byte (\w+)\[\w+\] PROGMEM =\n\{\n(.*?)\n\};",
+                         text, re.S):
+        tables[m.group(1)] = [int(v, 16) for v in re.findall(r"0x[0-9A-F]{2}", m.group(2))]
+    return tables
+
+
+def conformance(tables, rows):
+    """Looks every spec row up through the tables the way keyboard.cpp does."""
+    def bit(bits, code):
+        return bits[code >> 3] & (1 << (code & 7))
+
+    errors = []
+    for line, key, set2, set1, flags, name in rows:
+        if "std" in flags:
+            got = tables["kt_std"][set2]
+            back = tables["kt_std_rev"][set1]
+        else:
+            got = tables["kt_ext"][set2]
+            back = tables["kt_ext_rev"][set1]
+            for flag in FLAGS[1:]:
+                if bool(bit(tables["kt_%s_bits" % flag], set2)) != (flag in flags):
+                    errors.append("line %d: key %d %s flag mismatch" % (line, key, flag))
+        if got != set1:
+            errors.append("line %d: key %d 0x%02X -> 0x%02X, expected 0x%02X"
+                          % (line, key, set2, got, set1))
+        if back != set2:
+            errors.append("line %d: key %d reverse 0x%02X -> 0x%02X, expected 0x%02X"
+                          % (line, key, set1, back, set2))
+
+    # Every printable character can be typed
+    ascii = tables.get("kt_ascii", [0] * ASCII_SIZE)
+    for c in range(0x20, 0x7F):
+        if ascii[c] & ~SHIFT == 0:
+            errors.append("character %r can not be typed" % chr(c))
+    return errors
+
+
+def main(argv):
+    try:
+        rows = read_spec(SPEC_FILE)
+        tables = build_tables(rows)
+    except SpecError as e:
+        print("keys.csv: %s" % e, file=sys.stderr)
+        return 1
+
+    text = render(tables, rows)
+
+    if "--check" in argv:
+        try:
+            with open(HEADER_FILE) as f:
+                current = f.read()
+        except OSError:
+            current = ""
+        errors = conformance(parse_header(current), rows)
+        if current != text:
+            errors.append("key_tables.h is out of date, run tools/gen_key_tables.py")
+        for error in errors:
+            print(error, file=sys.stderr)
+        if errors:
+            return 1
+        print("%d keys OK" % len(rows))
+        return 0
+
+    with open(HEADER_FILE, "w") as f:
+        f.write(text)
+    print("Wrote key_tables.h from %d keys" % len(rows))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,259 @@
+#!/usr/bin/env python3
+"""
+timing_sweep.py
+
+Sweeps the kbt timing delays against a range of keyboards and XT hosts
+using a model of the bus senders in PS2KBTool.ino, and recommends a timing
+profile.
+
+  python3 tools/timing_sweep.py                 full sweep on all CPU cores
+  python3 tools/timing_sweep.py --keys 500      keystrokes per session
+  python3 tools/timing_sweep.py --jobs 1        run in a single process
+  python3 tools/timing_sweep.py --csv out.csv   also write every result
+
+Each session types a reproducible burst of keys, with E0 prefixed keys
+and Caps Lock LED updates mixed in, through one combination of timings,
+keyboard clock rate and host tolerance. It reports the mean key latency,
+the most keys per second the converter can pass on and the fraction of
+bytes the host or keyboard would get wrong. Each timing combination is
+scored on its worst environment, then the Pareto frontier of latency,
+throughput and error rate is printed with the recommended profile as kxxx
+commands ready to paste into program mode.
+
+The model is only as good as its constants below, which are estimates for
+a 16MHz Nano. at_next_delay and at_start_delay are not swept as nothing in
+the firmware uses them.
+
+This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+to use for non-commercial purposes.
+"""
+
+import argparse
+import csv
+import itertools
+import multiprocessing
+import random
+import sys
+
+# Cost of the Arduino pin calls and of the Timer0 (millis) ISR, which can
+# land in any delayMicroseconds() and stretch it
+PIN_WRITE_US = 4.0
+PIN_READ_US = 3.5
+TIMER0_ISR_US = 6.0
+TIMER0_PERIOD_US = 1024.0
+
+# processKeyPress() and the AT receiver ISR per received byte
+TRANSLATE_US = 60.0
+
+# Timing values swept, the defaults in globals.h are included in each
+SWEEP = {
+    "at_bit_delay": [10, 20, 30, 40, 50],
+    "xt_bit_delay": [10, 20, 30, 40, 60],
+    "xt_next_delay": [20, 50, 100, 200],
+    "xt_start_delay": [2, 5, 10, 20],
+}
+
+# Environments each combination is typed through
+KB_CLOCK_KHZ = [10.0, 12.5, 16.7]       # Keyboard clock rate
+KB_MIN_INHIBIT_US = [40.0, 60.0]        # Shortest request to send the keyboard sees
+HOST_MIN_LOW_US = [5.0, 10.0, 20.0]     # Shortest XT_CLK low pulse the host latches
+HOST_SETUP_US = [5.0, 15.0]             # XT_DATA setup before the host samples it
+HOST_SERVICE_US = [40.0, 80.0]          # Host time to read a byte and clear its shift register
+HOST_JITTER_US = 2.0                    # Spread of the host's thresholds
+
+EXT_FRACTION = 0.2      # Keys sent with an E0 prefix
+CAPS_FRACTION = 0.05    # Keys that toggle Caps Lock and update the LED's
+
+
+def stretch(rng, us):
+    """A delayMicroseconds(us), stretched if the Timer0 ISR lands in it."""
+    if rng.random() < us / TIMER0_PERIOD_US:
+        return us + TIMER0_ISR_US
+    return us
+
+
+def xt_byte(rng, t, env):
+    """Sends one byte to the XT host. Returns (uSecs, bit errors)."""
+    errors = 0
+    time = stretch(rng, t["xt_start_delay"])
+    # Start bit, 8 data bits and the stop bit
+    for bit in range(10):
+        low = PIN_WRITE_US + stretch(rng, t["xt_bit_delay"])
+        setup = t["xt_start_delay"] + low if bit else low
+        if low < rng.gauss(env["host_min_low"], HOST_JITTER_US):
+            errors += 1
+        elif setup < rng.gauss(env["host_setup"], HOST_JITTER_US):
+            errors += 1
+        time += low + PIN_WRITE_US + stretch(rng, t["xt_bit_delay"])
+        if bit:
+            time += PIN_WRITE_US + stretch(rng, t["xt_start_delay"])
+    return time, errors
+
+
+def at_byte(rng, t, env):
+    """Sends one byte to the keyboard. Returns (uSecs, errors)."""
+    period = 1000.0 / env["kb_clock"]
+    rts = 2 * PIN_WRITE_US + stretch(rng, t["at_bit_delay"]) + stretch(rng, t["at_bit_delay"])
+    if rts < env["kb_min_inhibit"]:
+        # The keyboard never clocks, sendAtCode() times out
+        return rts + 15000.0, 1
+    errors = 0
+    time = rts + period
+    # 8 data bits and the parity bit. Each is written after seeing AT_CLK
+    # low, then AT_CLK is polled for low again after 2 * at_bit_delay.
+    for bit in range(9):
+        poll = rng.uniform(0, PIN_READ_US) + PIN_WRITE_US + \
+            stretch(rng, t["at_bit_delay"]) + stretch(rng, t["at_bit_delay"])
+        # Too soon sees the same low clock again, too late misses the next
+        # one, either way the bits slip
+        if poll < period / 2 or poll + PIN_WRITE_US >= period * 1.5:
+            errors += 1
+        time += period
+    return time, errors
+
+
+def session(args):
+    """Types one reproducible session through one combination."""
+    index, timings, env, keys = args
+    t = dict(zip(SWEEP, timings))
+    # Every combination types the same keys through an environment
+    rng = random.Random(env["seed"])
+    at_frame = 11 * 1000.0 / env["kb_clock"]
+
+    busy = 0.0
+    latency = 0.0
+    errors = 0
+    xt_bytes = 0
+    at_bytes = 0
+
+    for key in range(keys):
+        ext = rng.random() < EXT_FRACTION
+        for release in (False, True):
+            # AT codes in, (E0) (F0) code, each translated as it arrives
+            received = (2 if ext else 1) + (1 if release else 0)
+            busy += received * (at_frame + TRANSLATE_US)
+            key_time = at_frame + TRANSLATE_US
+            if ext:
+                time, bad = xt_byte(rng, t, env)
+                gap = PIN_WRITE_US + stretch(rng, t["xt_next_delay"])
+                # The code is lost if the host is still reading the E0
+                if gap < rng.gauss(env["host_service"], HOST_JITTER_US):
+                    bad += 1
+                busy += time + gap
+                key_time += time + gap
+                errors += bad > 0
+                xt_bytes += 1
+            time, bad = xt_byte(rng, t, env)
+            busy += time
+            key_time += time
+            errors += bad > 0
+            xt_bytes += 1
+            if not release:
+                latency += key_time
+        if rng.random() < CAPS_FRACTION:
+            # 0xED then the LED byte
+            for n in range(2):
+                time, bad = at_byte(rng, t, env)
+                busy += time + at_frame
+                errors += bad > 0
+                at_bytes += 1
+
+    return index, {
+        "latency": latency / keys,
+        "throughput": keys / (busy / 1e6),
+        "errors": errors / float(xt_bytes + at_bytes),
+    }
+
+
+def environments():
+    for seed, (kb_clock, kb_min_inhibit, host_min_low, host_setup, host_service) in enumerate(itertools.product(
+            KB_CLOCK_KHZ, KB_MIN_INHIBIT_US, HOST_MIN_LOW_US, HOST_SETUP_US, HOST_SERVICE_US)):
+        yield {
+            "seed": seed,
+            "kb_clock": kb_clock,
+            "kb_min_inhibit": kb_min_inhibit,
+            "host_min_low": host_min_low,
+            "host_setup": host_setup,
+            "host_service": host_service,
+        }
+
+
+def pareto(scores):
+    """Combinations not beaten on latency, throughput and error rate at once."""
+    front = []
+    for t, s in scores.items():
+        dominated = False
+        for u, o in scores.items():
+            if u == t:
+                continue
+            if (o["latency"] <= s["latency"] and o["throughput"] >= s["throughput"] and
+                    o["errors"] <= s["errors"] and
+                    (o["latency"], -o["throughput"], o["errors"]) !=
+                    (s["latency"], -s["throughput"], s["errors"])):
+                dominated = True
+                break
+        if not dominated:
+            front.append(t)
+    return sorted(front, key=lambda t: (scores[t]["errors"], scores[t]["latency"]))
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description="Sweep the kbt timing delays.")
+    parser.add_argument("--keys", type=int, default=100, help="keystrokes per session")
+    parser.add_argument("--jobs", type=int, default=multiprocessing.cpu_count(),
+                        help="worker processes, defaults to the number of CPU cores")
+    parser.add_argument("--csv", help="write every session result to this file")
+    args = parser.parse_args(argv)
+
+    combos = list(itertools.product(*SWEEP.values()))
+    envs = list(environments())
+    jobs = [(i, combo, env, args.keys)
+            for i, (combo, env) in enumerate(itertools.product(combos, envs))]
+
+    if args.jobs > 1:
+        with multiprocessing.Pool(args.jobs) as pool:
+            results = dict(pool.imap_unordered(session, jobs, chunksize=64))
+    else:
+        results = dict(map(session, jobs))
+
+    # Score each combination on its worst environment
+    scores = {}
+    for i, combo, env, keys in jobs:
+        r = results[i]
+        s = scores.setdefault(combo, {"latency": 0.0, "throughput": float("inf"), "errors": 0.0})
+        s["latency"] = max(s["latency"], r["latency"])
+        s["throughput"] = min(s["throughput"], r["throughput"])
+        s["errors"] = max(s["errors"], r["errors"])
+
+    if args.csv:
+        with open(args.csv, "w", newline="") as f:
+            writer = csv.writer(f)
+            writer.writerow(list(SWEEP) + list(envs[0]) + ["latency", "throughput", "errors"])
+            for i, combo, env, keys in jobs:
+                r = results[i]
+                writer.writerow(list(combo) + list(env.values()) +
+                                ["%.1f" % r["latency"], "%.1f" % r["throughput"],
+                                 "%.5f" % r["errors"]])
+
+    print("%d sessions, %d timing combinations, %d environments"
+          % (len(jobs), len(combos), len(envs)))
+    print()
+    print("Pareto frontier (worst environment)")
+    print("%s  latency_us  keys_per_s  error_rate" % "  ".join("%-14s" % k for k in SWEEP))
+    front = pareto(scores)
+    for t in front:
+        s = scores[t]
+        print("%s  %10.0f  %10.1f  %10.5f" % ("  ".join("%-14d" % v for v in t),
+                                               s["latency"], s["throughput"], s["errors"]))
+
+    best = front[0]
+    print()
+    print("Recommended profile, %.0f uSec latency, %.1f keys/s, %.5f error rate"
+          % (scores[best]["latency"], scores[best]["throughput"], scores[best]["errors"]))
+    for name, command in zip(SWEEP, ("kabd", "kxbd", "kxnd", "kxsd")):
+        print("%s %d" % (command, dict(zip(SWEEP, best))[name]))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv[1:]))
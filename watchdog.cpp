@@ -0,0 +1,142 @@
+/*
+ * watchdog.cpp
+ * 
+ * Bus wait timeouts and the run mode hardware watchdog. The watchdog runs
+ * in interrupt and reset mode so the first timeout can record the wait
+ * state before the second one resets. The record is kept in RAM that is
+ * not cleared on reset so it can be reported after the reboot.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+*/
+
+#include <Arduino.h>
+#include <avr/wdt.h>
+
+#include "globals.h"
+
+#include "serial_utils.h"
+#include "watchdog.h"
+
+#define WD_MAGIC                0x3D0C
+
+// WDTCSR prescaler bits for a WDTO_xxx timeout, WDP3 is not next to the others
+#define WD_PRESCALE             ((WD_TIMEOUT & 0x07) | ((WD_TIMEOUT & 0x08) ? _BV(WDP3) : 0))
+
+struct wd_record
+{
+  unsigned int magic;
+  unsigned int resets;          // Watchdog resets since power up
+  byte last_hang;               // WD_xxx state at the last watchdog reset
+  bool pending;                 // The last watchdog reset has not been reported
+  unsigned int timeouts[WD_REASONS]; // Waits that ran out of time this run
+};
+
+static const char wd_names[WD_REASONS][11] PROGMEM =
+{
+  "loop",
+  "at_rx",
+  "at_release",
+  "at_tx",
+  "xt_tx",
+  "xoff"
+};
+
+static struct wd_record wd __attribute__((section(".noinit")));
+
+volatile byte wd_state = WD_LOOP;
+
+//*************************************************************************
+// First timeout, the watchdog resets on the next one unless kicked. Is
+// never kicked after this as the main loop has stopped.
+ISR(WDT_vect)
+{
+  wd.resets++;
+  wd.last_hang = wd_state;
+  wd.pending = true;
+}
+
+//*************************************************************************
+void wdInit()
+{
+  // A watchdog reset leaves the watchdog running at its shortest timeout
+  MCUSR &= ~_BV(WDRF);
+  wdt_disable();
+
+  if (wd.magic != WD_MAGIC || wd.last_hang >= WD_REASONS)
+  {
+    memset(&wd, 0, sizeof(wd));
+    wd.magic = WD_MAGIC;
+  }
+}
+
+//*************************************************************************
+void wdStart()
+{
+  byte sreg = SREG;
+
+  memset(wd.timeouts, 0, sizeof(wd.timeouts));
+  wd_state = WD_LOOP;
+
+  cli();
+  wdt_reset();
+  WDTCSR = _BV(WDCE) | _BV(WDE);
+  WDTCSR = _BV(WDIE) | _BV(WDE) | WD_PRESCALE;
+  SREG = sreg;
+}
+
+//*************************************************************************
+void wdTimeout(const byte reason)
+{
+  if (reason < WD_REASONS && wd.timeouts[reason] < 0xFFFF)
+  {
+    wd.timeouts[reason]++;
+  }
+}
+
+//*************************************************************************
+bool wdReport()
+{
+  if (!wd.pending)
+  {
+    return false;
+  }
+  wd.pending = false;
+
+  sHostPrint(F(T_MSG_53));
+  sHostPrintln((const __FlashStringHelper *) wd_names[wd.last_hang]);
+  return true;
+}
+
+//*************************************************************************
+void wdPrint()
+{
+  sHostPrint(F(T_MSG_51));
+  sHostPrintNum(wd.resets, DEC);
+  sHostPrintln();
+  if (wd.resets > 0)
+  {
+    sHostPrint(F(T_MSG_52));
+    sHostPrintln((const __FlashStringHelper *) wd_names[wd.last_hang]);
+  }
+
+  for (byte reason = 0; reason < WD_REASONS; reason++)
+  {
+    if (wd.timeouts[reason] == 0)
+    {
+      continue;
+    }
+    sHostPrint(F("WD,"));
+    sHostPrint((const __FlashStringHelper *) wd_names[reason]);
+    sHostPrint(',');
+    sHostPrintNum(wd.timeouts[reason], DEC);
+    sHostPrintln();
+  }
+}
@@ -0,0 +1,94 @@
+#ifndef _WATCHDOG_H_
+#define _WATCHDOG_H_
+
+/*
+ * watchdog.h
+ * 
+ * Bus wait timeouts and the run mode hardware watchdog.
+ * 
+ * Every wait on the AT bus or for XON has a deadline. A wait that runs out
+ * is counted against its WD_xxx reason and the caller takes its error path.
+ * Anything else that stops the main loop is caught by the watchdog, which
+ * records the last WD_xxx state entered before resetting, so the reason
+ * can be reported after the reboot.
+ * 
+ * This software is copyright 2024-2025 by Gary Hammond (ZL3GH). It is free
+ * to use for non-commercial purposes.
+ * 
+ * WARNING: DO NOT USE this software in any medical device or for any 
+ * other mission critical purpose.
+ * 
+ * Use of this software could result in a universe ending paradox so 
+ * use entirely at your own risk. No warranties or guarantees are 
+ * expressed or implied.
+ */
+
+#include <avr/wdt.h>
+
+// Wait states and timeout reasons
+#define WD_LOOP                 0       // Main loop, not waiting
+#define WD_AT_RX                1       // Waiting for an AT frame being received to finish
+#define WD_AT_RELEASE           2       // Waiting for the keyboard to release AT_CLK after a frame
+#define WD_AT_TX                3       // Waiting for the keyboard to clock a byte sent to it
+#define WD_XT_TX                4       // Clocking a byte out to the XT host
+#define WD_XOFF                 5       // Waiting for XON from the host
+#define WD_REASONS              6       // Always keep at the end
+
+extern volatile byte wd_state;
+
+// Marks the wait the main loop is in for the watchdog to report
+#define WD_STATE(state)         (wd_state = (state))
+
+/*************************************************************************
+ * wdInit
+ * 
+ * Turns off the watchdog left running by a watchdog reset and validates
+ * the record of the last hang. Call early in setup().
+ *************************************************************************/
+void wdInit();
+
+/*************************************************************************
+ * wdStart
+ * 
+ * Clears the timeout counts and arms the watchdog for WD_TIMEOUT. Called
+ * when booting into run mode, after which wdKick() must be called at
+ * least that often.
+ *************************************************************************/
+void wdStart();
+
+/*************************************************************************
+ * wdKick
+ * 
+ * Restarts the watchdog timeout.
+ *************************************************************************/
+static inline void wdKick() __attribute__((always_inline));
+static inline void wdKick()
+{
+  wdt_reset();
+}
+
+/*************************************************************************
+ * wdTimeout
+ * 
+ * Counts a wait that ran out of time against 'reason'.
+ *************************************************************************/
+void wdTimeout(const byte reason);
+
+/*************************************************************************
+ * wdReport
+ * 
+ * Prints the reason for a watchdog reset once after the reboot. Returns
+ * false if there was nothing to report.
+ *************************************************************************/
+bool wdReport();
+
+/*************************************************************************
+ * wdPrint
+ * 
+ * Prints the watchdog reset count, the reason for the last one and
+ * WD,<reason>,<count> lines for the wait timeouts of the last run to the
+ * host serial port.
+ *************************************************************************/
+void wdPrint();
+
+#endif // _WATCHDOG_H_